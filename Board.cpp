@@ -1,4 +1,5 @@
 #include "Board.h"
+#include "Symmetry.h"
 #include <cassert>
 #include <cstdlib>
 #include <cstring>
@@ -6,10 +7,155 @@
 
 Board::Board(int width, int height) :
     width(width), height(height),
-    edges(num_edges(), false),
-    decider(NULL)
+    symmetry(NULL), decider(NULL)
 {
     score[0] = score[1] = 0;
+    check_size();
+    resize();
+    recount();
+}
+
+// Edge coordinates have to fit in its bitfields
+void Board::check_size() const
+{
+    if (width < 1 || height < 1 || width >= (1 << 14) || height >= (1 << 14)) {
+        fprintf(stderr, "board size %dx%d is not supported\n", width, height);
+        exit(1);
+    }
+}
+
+// empties the board for its width and height
+void Board::resize()
+{
+    edges = SmallArray<uint64_t, 2>((num_edges() + 63) / 64, 0);
+    degrees = SmallArray<unsigned char, 64>(width * height, 0);
+    for (int kind = 0; kind < 4; ++kind)
+        move_masks[kind] = edges;
+}
+
+// the random number each edge_index contributes to the hash (splitmix64)
+static uint64_t zobrist_key(int i)
+{
+    uint64_t z = (i + 1) * 0x9E3779B97F4A7C15ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+// recomputes the box degrees, free edge count and hashes from the edge set
+void Board::recount()
+{
+    free_edges = num_edges();
+    for (int w = 0; w < edges.size(); ++w)
+        free_edges -= __builtin_popcountll(edges[w]);
+
+    hash = 0;
+    std::fill(symmetric_hashes, symmetric_hashes + 8, 0);
+    std::for_each(edge_begin(), edge_end(), [&] (Edge edge)
+            {
+                if (this->in_bounds(edge) && this->is_filled(edge))
+                    this->update_hash(edge);
+            });
+
+    for_each_node([&] (Node node)
+            {
+                int sum = 0;
+                this->for_each_adjacent_edge(node, [&] (Edge edge)
+                    { sum += (int) this->is_filled(edge); });
+                this->degrees[this->box_index(node)] = sum;
+            });
+
+    std::for_each(edge_begin(), edge_end(), [&] (Edge edge)
+            {
+                if (this->in_bounds(edge))
+                    this->update_move_kind(edge);
+            });
+}
+
+// the kind of a free edge from the degrees of its boxes
+MoveKind Board::classify(Edge move) const
+{
+    MoveKind kind = MOVE_SAFE;
+    for_each_adjacent_node(move, [&] (Node node)
+            {
+                switch (this->degree(node)) {
+                    case 3: kind = MOVE_CAPTURE; break;
+                    case 2: if (kind != MOVE_CAPTURE) kind = MOVE_SACRIFICE; break;
+                }
+            });
+    return kind;
+}
+
+void Board::update_move_kind(Edge edge)
+{
+    int i = edge_index(edge);
+    uint64_t bit = ((uint64_t)1) << (i & 63);
+    for (int kind = 0; kind < 4; ++kind)
+        move_masks[kind][i >> 6] &= ~bit;
+
+    if (!is_filled(edge)) {
+        move_masks[MOVE_ANY][i >> 6] |= bit;
+        move_masks[classify(edge)][i >> 6] |= bit;
+    }
+}
+
+// the edges whose kind can change when move is played or taken back: the
+// move itself and the sides of the boxes next to it
+void Board::update_move_kinds(Edge move)
+{
+    update_move_kind(move);
+    for_each_adjacent_node(move, [&] (Node node)
+            {
+                this->for_each_adjacent_edge(node, [&] (Edge edge)
+                    { this->update_move_kind(edge); });
+            });
+}
+
+Edge Board::nth_move(MoveKind kind, int n) const
+{
+    const SmallArray<uint64_t, 2> &mask = move_masks[kind];
+    for (int w = 0; w < mask.size(); ++w) {
+        int count = __builtin_popcountll(mask[w]);
+        if (n >= count) {
+            n -= count;
+            continue;
+        }
+
+        uint64_t bits = mask[w];
+        for (; n > 0; --n)
+            bits &= bits - 1;
+        return edge_at(w * 64 + __builtin_ctzll(bits));
+    }
+
+    assert(false);
+    return Edge(HORIZ, -1, -1);
+}
+
+void Board::track_symmetric_hash(const BoardSymmetry *symmetry)
+{
+    this->symmetry = symmetry;
+    recount();
+}
+
+uint64_t Board::get_symmetric_hash(int *transform) const
+{
+    assert(symmetry);
+    const uint64_t *best = std::min_element(symmetric_hashes,
+            symmetric_hashes + symmetry->num_transforms());
+    if (transform)
+        *transform = best - symmetric_hashes;
+    return *best;
+}
+
+void Board::update_hash(Edge edge)
+{
+    int i = edge_index(edge);
+    hash ^= zobrist_key(i);
+
+    if (symmetry) {
+        for (int t = 0; t < symmetry->num_transforms(); ++t)
+            symmetric_hashes[t] ^= zobrist_key(symmetry->transform_index(t, i));
+    }
 }
 
 bool Board::move(int player, Edge move)
@@ -18,10 +164,13 @@ bool Board::move(int player, Edge move)
 
     int oldscore = score[player];
 
-    edges[edge_index(move)] = true;
+    set_filled(move, true);
+    --free_edges;
+    update_hash(move);
 
     for_each_adjacent_node(move, [&] (Node node)
-            { if (this->degree(node) == 4) ++score[player]; });
+            { if (++this->degrees[this->box_index(node)] == 4) ++score[player]; });
+    update_move_kinds(move);
 
     return oldscore != score[player];
 }
@@ -30,36 +179,26 @@ void Board::unmove(int player, Edge move)
 {
     assert(!is_move_valid(move));
 
-    edges[edge_index(move)] = false;
+    set_filled(move, false);
+    ++free_edges;
+    update_hash(move);
 
     for_each_adjacent_node(move, [&] (Node node)
-            { if (this->degree(node) == 3) --score[player]; });
+            { if (this->degrees[this->box_index(node)]-- == 4) --score[player]; });
+    update_move_kinds(move);
 }
 
-bool Board::is_move_valid(Edge move) const
+bool Board::in_bounds(Edge edge) const
 {
-    if (move.dir == HORIZ) {
-        if (move.x < 0 || move.x >= width || move.y < 0 || move.y > height)
-            return false;
-    } else {
-        if (move.x < 0 || move.x > width || move.y < 0 || move.y >= height)
-            return false;
-    }
-
-    return !edges[edge_index(move)];
-}
-
-bool Board::is_game_over() const
-{
-    return std::count(edges.begin(), edges.end(), false) == 0;
+    if (edge.dir == HORIZ)
+        return edge.x >= 0 && edge.x < width && edge.y >= 0 && edge.y <= height;
+    else
+        return edge.x >= 0 && edge.x <= width && edge.y >= 0 && edge.y < height;
 }
 
-int Board::degree(Node node) const
+bool Board::is_move_valid(Edge move) const
 {
-    int sum = 0;
-    for_each_adjacent_edge(node, [&] (Edge edge)
-            { sum += (int) edges[this->edge_index(edge)]; });
-    return sum;
+    return in_bounds(move) && !is_filled(move);
 }
 
 std::string basename_str(const std::string &str)
@@ -86,6 +225,18 @@ void Board::set_move_decider(const std::string &solver)
         exit(1);
     } else if (base == "nocheap") {
         decider = &Board::decide_move_nocheap;
+    } else if (base == "perfect") {
+        decider = &Board::decide_move_perfect;
+    } else if (base == "negamax") {
+        decider = &Board::decide_move_negamax;
+    } else if (base == "montecarlo") {
+        decider = &Board::decide_move_montecarlo;
+    } else if (base == "mcts") {
+        decider = &Board::decide_move_mcts;
+    } else if (base == "nimstring") {
+        decider = &Board::decide_move_nimstring;
+    } else if (base == "ybwc") {
+        decider = &Board::decide_move_ybwc;
     } else {
         fprintf(stderr, "dots solver run with command: %s, cannot decide which move decider to use\n", base.c_str());
         exit(1);
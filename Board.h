@@ -5,6 +5,9 @@
 #include <string>
 #include <cstdio>
 #include <iterator>
+#include <stdint.h>
+
+#include "SmallArray.h"
 
 enum Direction
 {
@@ -15,8 +18,8 @@ enum Direction
 struct Edge
 {
     unsigned dir:1;
-    signed x:7;
-    signed y:8;
+    signed x:15;
+    signed y:16;
 
     Edge() {}
     Edge(Direction dir, int x, int y) :
@@ -43,7 +46,7 @@ Edge read_edge(FILE *fp);
 
 struct Node
 {
-    signed char x, y;
+    short x, y;
 
     Node() {}
     Node(int x, int y) : x(x), y(y) {}
@@ -157,6 +160,18 @@ class NodeIterator
         int width;
 };
 
+// what a move does to the boxes next to it: completes one, hands one to the
+// opponent by making its third side, or neither
+enum MoveKind
+{
+    MOVE_ANY,
+    MOVE_CAPTURE,
+    MOVE_SACRIFICE,
+    MOVE_SAFE
+};
+
+class BoardSymmetry;
+
 class Board
 {
     public:
@@ -166,16 +181,45 @@ class Board
         int get_height() const { return height; }
 
         int edge_index(Edge edge) const;
+        // the edge with edge_index i
+        Edge edge_at(int i) const;
         int num_edges() const;
+        // the filled edges as a bitmask over edge_index, needs num_edges() <= 64
+        uint64_t edge_mask() const { return edges[0]; }
+        // the same for any size, one bit per edge_index
+        const uint64_t *edge_words() const { return edges.data(); }
+        int num_edge_words() const { return edges.size(); }
 
         bool move(int player, Edge move);
         void unmove(int player, Edge move);
         bool is_move_valid(Edge move) const;
-        bool is_game_over() const;
+        bool is_game_over() const { return free_edges == 0; }
         int get_score(int player) const { return score[player]; }
         void reset_score() { score[0] = score[1] - 0; }
 
-        int degree(Node node) const;
+        // Zobrist hash of the filled edges
+        uint64_t get_hash() const { return hash; }
+        // also keep the hash of every symmetric position, symmetry has to
+        // outlive the board and its copies
+        void track_symmetric_hash(const BoardSymmetry *symmetry);
+        // the same for all positions symmetric to this one. If transform
+        // isn't NULL it is set to a transform that takes this position to
+        // the one whose hash it is
+        uint64_t get_symmetric_hash(int *transform = NULL) const;
+
+        int degree(Node node) const { return degrees[box_index(node)]; }
+        int num_free_edges() const { return free_edges; }
+        // MOVE_CAPTURE takes precedence when a move does both. Kept up to
+        // date for every free edge by move and unmove, as one bitset per kind
+        MoveKind move_kind(Edge move) const;
+        int num_moves(MoveKind kind = MOVE_ANY) const;
+        // the move of that kind with n lower edge_indexes of the same kind
+        Edge nth_move(MoveKind kind, int n) const;
+
+        // calls f(edge) for every valid move of that kind in edge_index
+        // order, skipping straight over the others
+        template<class F> void for_each_move(F f) const { for_each_move(MOVE_ANY, f); }
+        template<class F> void for_each_move(MoveKind kind, F f) const;
 
         template<class F> void for_each_adjacent_node(Edge e, F f) const;
         template<class F> void for_each_adjacent_edge(Node n, F f) const;
@@ -197,14 +241,40 @@ class Board
         { return NodeIterator(Node(0, height), width); }
 
     private:
-        Board() {}
+        Board() : symmetry(NULL), decider(NULL) {}
         void print_horiz_edges(int y, FILE *fp) const;
         void print_vert_edges(int y, FILE *fp) const;
         void read_horiz_edges(int y, FILE *fp);
         void read_vert_edges(int y, FILE *fp);
 
+        void check_size() const;
+        void resize();
+        void recount();
+        bool in_bounds(Edge edge) const;
+        int box_index(Node node) const { return node.y * width + node.x; }
+        bool is_filled(Edge edge) const;
+        void set_filled(Edge edge, bool filled);
+        MoveKind classify(Edge move) const;
+        void update_move_kind(Edge edge);
+        void update_move_kinds(Edge move);
+
         int width, height, score[2];
-        std::vector<bool> edges; // true if filled
+        // bit edge_index(edge) is set if the edge is filled, so the
+        // horizontal edges come first and then the vertical ones. Boards up to
+        // 128 edges keep them inline.
+        SmallArray<uint64_t, 2> edges;
+
+        void update_hash(Edge edge);
+
+        // kept up to date by move and unmove so they are cheap to query
+        int free_edges;
+        SmallArray<unsigned char, 64> degrees;
+        // indexed by MoveKind, bit edge_index(edge) is set if edge is a free
+        // edge of that kind; MOVE_ANY has every free edge
+        SmallArray<uint64_t, 2> move_masks[4];
+        uint64_t hash;
+        const BoardSymmetry *symmetry; // NULL unless tracking symmetric hashes
+        uint64_t symmetric_hashes[8];
 
         Edge (Board::*decider)();
 
@@ -213,6 +283,12 @@ class Board
         Edge decide_move_invalid();
         Edge decide_move_timeout();
         Edge decide_move_nocheap();
+        Edge decide_move_perfect();
+        Edge decide_move_negamax();
+        Edge decide_move_montecarlo();
+        Edge decide_move_mcts();
+        Edge decide_move_nimstring();
+        Edge decide_move_ybwc();
 
 
         friend Board read_board(FILE *fp);
@@ -228,11 +304,35 @@ inline int Board::edge_index(Edge edge) const
         return width * (height + 1) + edge.y * (width + 1) + edge.x;
 }
 
+inline Edge Board::edge_at(int i) const
+{
+    int nhoriz = width * (height + 1);
+    if (i < nhoriz)
+        return Edge(HORIZ, i % width, i / width);
+    i -= nhoriz;
+    return Edge(VERT, i % (width + 1), i / (width + 1));
+}
+
 inline int Board::num_edges() const
 {
     return width * (height + 1) + height * (width + 1);
 }
 
+inline bool Board::is_filled(Edge edge) const
+{
+    int i = edge_index(edge);
+    return (edges[i >> 6] >> (i & 63)) & 1;
+}
+
+inline void Board::set_filled(Edge edge, bool filled)
+{
+    int i = edge_index(edge);
+    if (filled)
+        edges[i >> 6] |= ((uint64_t)1) << (i & 63);
+    else
+        edges[i >> 6] &= ~(((uint64_t)1) << (i & 63));
+}
+
 template<class F>
 void Board::for_each_adjacent_edge(Node node, F f) const
 {
@@ -280,6 +380,35 @@ void Board::for_each_edge(F f) const
     }
 }
 
+inline MoveKind Board::move_kind(Edge move) const
+{
+    int i = edge_index(move);
+    if ((move_masks[MOVE_CAPTURE][i >> 6] >> (i & 63)) & 1)
+        return MOVE_CAPTURE;
+    if ((move_masks[MOVE_SACRIFICE][i >> 6] >> (i & 63)) & 1)
+        return MOVE_SACRIFICE;
+    return MOVE_SAFE;
+}
+
+inline int Board::num_moves(MoveKind kind) const
+{
+    const SmallArray<uint64_t, 2> &mask = move_masks[kind];
+    int n = 0;
+    for (int w = 0; w < mask.size(); ++w)
+        n += __builtin_popcountll(mask[w]);
+    return n;
+}
+
+template<class F>
+void Board::for_each_move(MoveKind kind, F f) const
+{
+    const SmallArray<uint64_t, 2> &mask = move_masks[kind];
+    for (int w = 0; w < mask.size(); ++w) {
+        for (uint64_t bits = mask[w]; bits; bits &= bits - 1)
+            f(edge_at(w * 64 + __builtin_ctzll(bits)));
+    }
+}
+
 template<class F>
 void Board::for_each_node(F f) const
 {
@@ -1,99 +1,698 @@
 #include "Board.h"
+#include "Symmetry.h"
+#include "PackedTable.h"
+#include "Tablebase.h"
+#include "Geometry.h"
+#include "ParallelSearch.h"
 
-#include "boost/algorithm/combination.hpp"
 #include <algorithm>
 #include <utility>
 #include <climits>
 #include <cassert>
 
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
 static void usage()
 {
-    printf("USAGE: ./brute_force <width> <height>\n");
+    printf("USAGE: ./brute_force [-s|-p|-y] [-q] [-j threads] [-l dir] [-o tablebase] <width> <height>\n"
+            "       ./brute_force [-p|-y] [-q] [-j threads] [-l dir] -b board\n"
+            "  -s  only solve positions that are canonical under the board's symmetries\n"
+            "  -p  only keep the score of each position, packed into as few bits as possible\n"
+            "  -y  only solve the starting position, by parallel alpha-beta search instead of a table\n"
+            "  -q  don't print solved positions, print progress for each level as JSON lines\n"
+            "  -j  solve the positions of each level (or search) on this many threads\n"
+            "  -l  only keep two levels in memory, writing each finished level to dir, named\n"
+            "      by the board size and, with -b, the starting position's hash\n"
+            "  -o  write the scores to a tablebase file for the perfect move decider\n"
+            "  -b  solve from the position in a board file instead of the empty board,\n"
+            "      indexing positions by its free edges only\n");
 
     exit(1);
 }
 
-void do_brute_force_one_level(const Board &oldboard,
-        std::vector<std::pair<Edge, short>> &table,
-        std::vector<Edge>::iterator first, std::vector<Edge>::iterator middle,
-        std::vector<Edge>::iterator last)
-{
-    do {
-        Board board(oldboard);
-
-        unsigned long idx = 0;
-        std::for_each(first, middle, [&] (Edge edge)
-                {
-                    idx |= (((unsigned long)1) << board.edge_index(edge));
-                    board.move(0, edge);
-                });
-        board.reset_score();
-
-        Edge bestMove;
-        int bestScoreDiff = INT_MIN;
-
-        std::for_each(board.edge_begin(), board.edge_end(), [&] (Edge edge)
-                {
-                    if (!board.is_move_valid(edge))
-                        return;
-                    int nextIdx = idx | (((unsigned long)1) << board.edge_index(edge));
-                    assert(table[nextIdx].second != SHRT_MAX);
-                    bool tookSquare = board.move(0, edge);
-                    if (tookSquare) {
-                        int nextScore = board.get_score(0) +
-                            table[nextIdx].second;
-                        if (nextScore > bestScoreDiff) {
-                            bestScoreDiff = nextScore;
-                            bestMove = edge;
-                        }
-                        
-                    } else {
-                        int nextScore = -table[nextIdx].second;
-                        if (nextScore > bestScoreDiff) {
-                            bestScoreDiff = nextScore;
-                            bestMove = edge;
+static pthread_mutex_t print_mutex = PTHREAD_MUTEX_INITIALIZER;
+static bool quiet = false;
+
+// Reports how far a quiet run has got as one JSON object per line, one for
+// each finished level and one with the result.
+class Progress
+{
+    public:
+        Progress(unsigned long total);
+
+        void level_done(int filled, unsigned long positions);
+        void finished(int score) const;
+
+    private:
+        double elapsed() const;
+
+        timeval start;
+        unsigned long total, solved;
+};
+
+Progress::Progress(unsigned long total) :
+    total(total), solved(0)
+{
+    gettimeofday(&start, NULL);
+}
+
+double Progress::elapsed() const
+{
+    timeval now;
+    gettimeofday(&now, NULL);
+    return (now.tv_sec - start.tv_sec) + (now.tv_usec - start.tv_usec) / 1e6;
+}
+
+static long peak_rss_kb()
+{
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+void Progress::level_done(int filled, unsigned long positions)
+{
+    solved += positions;
+    if (!quiet)
+        return;
+
+    double seconds = elapsed();
+    double rate = seconds > 0 ? solved / seconds : 0;
+    printf("{\"filled_edges\": %d, \"positions\": %lu, \"solved\": %lu, \"total\": %lu, "
+            "\"elapsed_sec\": %.3f, \"positions_per_sec\": %.0f, \"eta_sec\": %.3f, "
+            "\"peak_rss_kb\": %ld}\n",
+            filled, positions, solved, total, seconds, rate,
+            rate > 0 ? (total - solved) / rate : 0.0, peak_rss_kb());
+    fflush(stdout);
+}
+
+void Progress::finished(int score) const
+{
+    if (!quiet)
+        return;
+
+    printf("{\"result\": %d, \"elapsed_sec\": %.3f, \"peak_rss_kb\": %ld}\n",
+            score, elapsed(), peak_rss_kb());
+    fflush(stdout);
+}
+
+struct BinomialTable
+{
+    unsigned long table[65][65];
+
+    BinomialTable()
+    {
+        for (int i = 0; i <= 64; ++i) {
+            table[i][0] = 1;
+            for (int j = 1; j <= i; ++j)
+                table[i][j] = table[i - 1][j - 1] + (j < i ? table[i - 1][j] : 0);
+        }
+    }
+};
+
+static unsigned long binomial(int n, int k)
+{
+    static const BinomialTable binomials;
+    return k < 0 || k > n ? 0 : binomials.table[n][k];
+}
+
+// the first of total items handled by thread out of nthreads
+static unsigned long share_begin(unsigned long total, int thread, int nthreads)
+{
+    return total / nthreads * thread + std::min<unsigned long>(thread, total % nthreads);
+}
+
+// The k-combinations of bits are numbered by the combinatorial number
+// system, which is also the order they come in by numeric value
+static unsigned long combination_rank(unsigned long idx)
+{
+    unsigned long rank = 0;
+    for (int j = 1; idx; ++j, idx &= idx - 1)
+        rank += binomial(__builtin_ctzl(idx), j);
+    return rank;
+}
+
+static unsigned long combination_unrank(int k, unsigned long rank)
+{
+    unsigned long idx = 0;
+    for (int j = k; j > 0; --j) {
+        int c = j - 1;
+        while (binomial(c + 1, j) <= rank)
+            ++c;
+        rank -= binomial(c, j);
+        idx |= ((unsigned long)1) << c;
+    }
+    return idx;
+}
+
+// the next larger mask with the same number of bits set (Gosper's hack)
+static unsigned long next_combination_mask(unsigned long idx)
+{
+    unsigned long lowest = idx & -idx;
+    unsigned long ripple = idx + lowest;
+    return ripple | (((idx ^ ripple) >> 2) / lowest);
+}
+
+template<class F, class G>
+struct LevelWorker
+{
+    F *solve_share;
+    G *finish_level;
+    pthread_barrier_t *barrier;
+    int thread, nthreads, nlevels;
+
+    static void *run(void *arg)
+    {
+        LevelWorker *worker = (LevelWorker *)arg;
+        for (int level = 0; level < worker->nlevels; ++level) {
+            (*worker->solve_share)(level, worker->thread, worker->nthreads);
+            if (pthread_barrier_wait(worker->barrier) == PTHREAD_BARRIER_SERIAL_THREAD)
+                (*worker->finish_level)(level);
+            pthread_barrier_wait(worker->barrier);
+        }
+        return NULL;
+    }
+};
+
+// calls solve_share(level, thread, nthreads) from nthreads threads for each
+// level in turn, every thread finishes a level before any starts the next.
+// finish_level(level) is called from one thread in between.
+template<class F, class G>
+void for_each_level_parallel(int nthreads, int nlevels, F solve_share, G finish_level)
+{
+    pthread_barrier_t barrier;
+    pthread_barrier_init(&barrier, NULL, nthreads);
+
+    std::vector<LevelWorker<F, G>> workers(nthreads);
+    std::vector<pthread_t> threads(nthreads);
+    for (int thread = 0; thread < nthreads; ++thread) {
+        LevelWorker<F, G> worker = {&solve_share, &finish_level, &barrier,
+            thread, nthreads, nlevels};
+        workers[thread] = worker;
+        pthread_create(&threads[thread], NULL, &LevelWorker<F, G>::run, &workers[thread]);
+    }
+
+    for (int thread = 0; thread < nthreads; ++thread)
+        pthread_join(threads[thread], NULL);
+
+    pthread_barrier_destroy(&barrier);
+}
+
+template<class F>
+void for_each_level_parallel(int nthreads, int nlevels, F solve_share)
+{
+    for_each_level_parallel(nthreads, nlevels, solve_share, [] (int) {});
+}
+
+// Solves positions straight from their edge masks, without a Board: the
+// boxes a move completes are found by checking the masks of the boxes next to
+// the edge, which come from the board's Geometry. Masks only cover the edges
+// that are free in the board the solver was made for, numbered as the
+// geometry numbers them.
+template<class Geometry>
+class PositionSolver
+{
+    public:
+        PositionSolver(const Board &board, const Geometry &geometry);
+
+        int num_edges() const { return edges.size(); }
+        unsigned long full_mask() const { return full; }
+        Edge edge(int i) const { return edges[i]; }
+
+        template<class F>
+        std::pair<Edge, short> solve(unsigned long idx, F next_score) const;
+
+    private:
+        Geometry geometry;
+        unsigned long full;
+        std::vector<Edge> edges; // by edge_index
+};
+
+template<class Geometry>
+PositionSolver<Geometry>::PositionSolver(const Board &board, const Geometry &geometry) :
+    geometry(geometry), edges(free_edges(board))
+{
+    full = edges.size() == 64 ? ~0UL : (1UL << edges.size()) - 1;
+}
+
+// the same as solve_position, for the position with the edges in idx filled
+template<class Geometry>
+template<class F>
+std::pair<Edge, short> PositionSolver<Geometry>::solve(unsigned long idx, F next_score) const
+{
+    int bestMove = -1;
+    int bestScoreDiff = INT_MIN;
+
+    for (unsigned long free = full & ~idx; free; free &= free - 1) {
+        int i = __builtin_ctzl(free);
+        unsigned long nextIdx = idx ^ (free & -free);
+
+        unsigned long box0 = geometry.edge_box(i, 0), box1 = geometry.edge_box(i, 1);
+        int took = ((nextIdx & box0) == box0) + (box1 && (nextIdx & box1) == box1);
+
+        int nextScore = took ? took + next_score(nextIdx) : -next_score(nextIdx);
+        if (nextScore > bestScoreDiff) {
+            bestScoreDiff = nextScore;
+            bestMove = i;
+        }
+    }
+
+    return std::make_pair(bestMove == -1 ? Edge(HORIZ, -1, -1) : edges[bestMove],
+            (short)bestScoreDiff);
+}
+
+// prints the position with the edges in idx filled
+template<class Solver>
+void print_solved(const Board &oldboard, const Solver &solver,
+        unsigned long idx, const std::pair<Edge, short> &solved)
+{
+    if (quiet)
+        return;
+
+    Board board(oldboard);
+    for (unsigned long filled = idx; filled; filled &= filled - 1)
+        board.move(0, solver.edge(__builtin_ctzl(filled)));
+    board.reset_score();
+
+    pthread_mutex_lock(&print_mutex);
+    board.print(stdout);
+    solved.first.print(stdout);
+    printf("index: %lu, expect to win by: %d\n\n", idx, solved.second);
+    pthread_mutex_unlock(&print_mutex);
+}
+
+// the best move and score difference of every position, indexed by the
+// filled edges
+class DenseTable
+{
+    public:
+        DenseTable(unsigned long size) :
+            entries(size, std::make_pair(Edge(), SHRT_MAX)) {}
+
+        int score(unsigned long idx) const
+        {
+            assert(entries[idx].second != SHRT_MAX);
+            return entries[idx].second;
+        }
+        void store(unsigned long idx, const std::pair<Edge, short> &solved)
+        { entries[idx] = solved; }
+
+    private:
+        std::vector<std::pair<Edge, short>> entries;
+};
+
+// only the score difference of every position, best moves are found again by
+// solving from the scores of the following positions
+class PackedScoreTable : public PackedTable
+{
+    public:
+        PackedScoreTable(int nboxes, unsigned long size) :
+            PackedTable(nboxes, size) {}
+
+        int score(unsigned long idx) const { return get(idx); }
+        void store(unsigned long idx, const std::pair<Edge, short> &solved)
+        { set(idx, solved.second); }
+};
+
+// solves count positions with the same number of filled edges, starting at
+// idx and continuing in numeric order
+template<class Solver, class Table>
+void do_brute_force_one_level(const Board &oldboard, const Solver &solver,
+        Table &table, unsigned long idx, unsigned long count)
+{
+    for (;;) {
+        std::pair<Edge, short> solved = solver.solve(idx,
+                [&] (unsigned long nextIdx) { return table.score(nextIdx); });
+        table.store(idx, solved);
+
+        print_solved(oldboard, solver, idx, solved);
+
+        if (--count == 0)
+            break;
+        idx = next_combination_mask(idx);
+    }
+}
+
+template<class Solver, class Table>
+void brute_force(const Board &oldboard, const Solver &solver, Table &table, int nthreads)
+{
+    // initialize the final state
+    table.store(solver.full_mask(), std::make_pair(Edge(HORIZ, -1, -1), 0));
+
+    // level 0 has all but one of the edges filled, the last has none
+    int nedges = solver.num_edges();
+    Progress progress(solver.full_mask());
+    for_each_level_parallel(nthreads, nedges, [&] (int level, int thread, int nthreads)
+            {
+                int k = nedges - 1 - level;
+                unsigned long total = binomial(nedges, k);
+                unsigned long first = share_begin(total, thread, nthreads);
+                unsigned long last = share_begin(total, thread + 1, nthreads);
+                if (first == last)
+                    return;
+
+                do_brute_force_one_level(oldboard, solver, table,
+                    combination_unrank(k, first), last - first);
+            },
+            [&] (int level)
+            {
+                int k = nedges - 1 - level;
+                progress.level_done(k, binomial(nedges, k));
+            });
+
+    progress.finished(table.score(0));
+}
+
+// The positions that are the smallest of their symmetric equivalents. A bit
+// per position says whether it is one, and the canonical positions are
+// numbered in order by counting those bits, with the count before every block
+// of BLOCK_WORDS words kept to start from. Only their scores are stored,
+// packed and indexed by that number, so a symmetric table takes a bit
+// and an eighth per position plus the packed scores of the canonical ones.
+// Any position's score is found through its canonical form; best moves are
+// found again from the scores of the following positions.
+class CanonicalTable
+{
+    public:
+        CanonicalTable(const Board &board, int nthreads);
+        ~CanonicalTable() { delete scores; }
+
+        unsigned long size() const { return scores->size(); }
+        // canonical positions with k edges filled
+        unsigned long level_size(int k) const { return level_sizes[k]; }
+
+        bool is_canonical(unsigned long idx) const
+        { return (canonical[idx / 64] >> (idx % 64)) & 1; }
+        // of any position
+        int score(unsigned long idx) const { return scores->get(rank(symmetry.canonicalize(idx))); }
+        // of a canonical position
+        void store(unsigned long idx, int score) { scores->set(rank(idx), score); }
+
+    private:
+        static const int BLOCK_WORDS = 8;
+
+        CanonicalTable(const CanonicalTable &);
+        CanonicalTable &operator=(const CanonicalTable &);
+
+        unsigned long rank(unsigned long idx) const;
+
+        BoardSymmetry symmetry;
+        std::vector<uint64_t> canonical; // bit idx is set if idx is canonical
+        std::vector<unsigned long> block_ranks;
+        std::vector<unsigned long> level_sizes;
+        PackedTable *scores;
+};
+
+CanonicalTable::CanonicalTable(const Board &board, int nthreads) :
+    symmetry(board), level_sizes(board.num_edges() + 1, 0)
+{
+    int nedges = board.num_edges();
+    unsigned long nwords = std::max((((unsigned long)1) << nedges) / 64, 1UL);
+    canonical.resize(nwords);
+
+    // one pass over every position, split between the threads
+    for_each_level_parallel(nthreads, 1, [&] (int, int thread, int nthreads)
+            {
+                std::vector<unsigned long> counts(nedges + 1, 0);
+                unsigned long first = share_begin(nwords, thread, nthreads);
+                unsigned long last = share_begin(nwords, thread + 1, nthreads);
+
+                for (unsigned long w = first; w < last; ++w) {
+                    uint64_t bits = 0;
+                    for (int b = 0; b < 64 && w * 64 + b < (((unsigned long)1) << nedges); ++b) {
+                        unsigned long idx = w * 64 + b;
+                        bool smallest = true;
+                        for (int t = 1; t < this->symmetry.num_transforms() && smallest; ++t)
+                            smallest = this->symmetry.transform(t, idx) >= idx;
+                        if (smallest) {
+                            bits |= ((uint64_t)1) << b;
+                            ++counts[__builtin_popcountl(idx)];
                         }
                     }
-                    board.unmove(0, edge);
-                });
+                    this->canonical[w] = bits;
+                }
 
-        table[idx].first = bestMove;
-        table[idx].second = bestScoreDiff;
+                for (int k = 0; k <= nedges; ++k)
+                    __sync_fetch_and_add(&this->level_sizes[k], counts[k]);
+            });
 
-        board.print(stdout);
-        bestMove.print(stdout);
-        printf("index: %lu, expect to win by: %d\n\n", idx, bestScoreDiff);
-    } while (boost::next_combination(first, middle, last));
+    block_ranks.resize((nwords + BLOCK_WORDS - 1) / BLOCK_WORDS + 1);
+    unsigned long count = 0;
+    for (unsigned long w = 0; w < nwords; ++w) {
+        if (w % BLOCK_WORDS == 0)
+            block_ranks[w / BLOCK_WORDS] = count;
+        count += __builtin_popcountl(canonical[w]);
+    }
+    block_ranks.back() = count;
+
+    scores = new PackedTable(board.get_width() * board.get_height(), count);
 }
 
-void brute_force(const Board &oldboard)
+// the number of canonical positions before idx
+unsigned long CanonicalTable::rank(unsigned long idx) const
 {
-    std::vector<Edge> edges;
+    unsigned long word = idx / 64;
+    unsigned long rank = block_ranks[word / BLOCK_WORDS];
+    for (unsigned long w = word / BLOCK_WORDS * BLOCK_WORDS; w < word; ++w)
+        rank += __builtin_popcountl(canonical[w]);
+    return rank + __builtin_popcountl(canonical[word] & ((((uint64_t)1) << (idx % 64)) - 1));
+}
 
-    std::for_each(oldboard.edge_begin(), oldboard.edge_end(), [&] (Edge edge)
-            { if (oldboard.is_move_valid(edge)) edges.push_back(edge); });
+// solves the canonical positions a level at a time as brute_force does,
+// passing over the rest
+template<class Solver>
+void brute_force_symmetric(const Board &oldboard, const Solver &solver, int nthreads)
+{
+    CanonicalTable table(oldboard, nthreads);
+    Progress progress(table.size());
 
-    std::vector<std::pair<Edge, short>> table;
-    table.resize(((unsigned long)1) << oldboard.num_edges(), std::make_pair(Edge(), SHRT_MAX));
-    table.back().second = 0; // initialize the final state
+    // level 0 has all but one of the edges filled, the last has none
+    int nedges = solver.num_edges();
+    table.store(solver.full_mask(), 0);
+    for_each_level_parallel(nthreads, nedges, [&] (int level, int thread, int nthreads)
+            {
+                int k = nedges - 1 - level;
+                unsigned long total = binomial(nedges, k);
+                unsigned long first = share_begin(total, thread, nthreads);
+                unsigned long last = share_begin(total, thread + 1, nthreads);
 
-    std::sort(edges.begin(), edges.end());
-    for (std::vector<Edge>::iterator middle = --edges.end();
-            middle != edges.begin(); --middle) {
-        do_brute_force_one_level(oldboard, table, edges.begin(), middle, edges.end());
+                unsigned long idx = combination_unrank(k, first);
+                for (unsigned long rank = first; rank < last; ++rank) {
+                    if (table.is_canonical(idx)) {
+                        std::pair<Edge, short> solved = solver.solve(idx,
+                                [&] (unsigned long nextIdx) { return table.score(nextIdx); });
+                        table.store(idx, solved.second);
+                        print_solved(oldboard, solver, idx, solved);
+                    }
+
+                    if (rank + 1 < last)
+                        idx = next_combination_mask(idx);
+                }
+            },
+            [&] (int level)
+            {
+                int k = nedges - 1 - level;
+                progress.level_done(k, table.level_size(k));
+            });
+
+    progress.finished(table.score(0));
+}
+
+// levels solved from a position other than the empty board have its hash
+// in their names, so different positions of one size don't share files
+static void write_level(const char *dir, const Board &board, int k,
+        const std::vector<std::pair<Edge, short>> &level)
+{
+    char path[4096];
+    if (board.num_free_edges() == board.num_edges())
+        snprintf(path, sizeof(path), "%s/%dx%d.level%d", dir,
+                board.get_width(), board.get_height(), k);
+    else
+        snprintf(path, sizeof(path), "%s/%dx%d-%016llx.level%d", dir,
+                board.get_width(), board.get_height(),
+                (unsigned long long)board.get_hash(), k);
+
+    FILE *fp = fopen(path, "wb");
+    if (!fp || fwrite(&level[0], sizeof(level[0]), level.size(), fp) != level.size() ||
+            fclose(fp) != 0) {
+        perror(path);
+        exit(1);
+    }
+}
+
+// Only keeps the level being solved and the one below it in memory, each
+// indexed by combination_rank of the filled edges. Finished levels are
+// written to dir as they complete.
+template<class Solver>
+void brute_force_streamed(const Board &oldboard, const Solver &solver,
+        int nthreads, const char *dir)
+{
+    int nedges = solver.num_edges();
+    std::vector<std::pair<Edge, short>> below(1, std::make_pair(Edge(HORIZ, -1, -1), 0));
+    std::vector<std::pair<Edge, short>> current(binomial(nedges, nedges - 1));
+    write_level(dir, oldboard, nedges, below);
+    Progress progress(solver.full_mask());
+
+    // level 0 has all but one of the edges filled, the last has none
+    for_each_level_parallel(nthreads, nedges, [&] (int level, int thread, int nthreads)
+            {
+                int k = nedges - 1 - level;
+                unsigned long total = binomial(nedges, k);
+                unsigned long first = share_begin(total, thread, nthreads);
+                unsigned long last = share_begin(total, thread + 1, nthreads);
+
+                unsigned long idx = combination_unrank(k, first);
+                for (unsigned long rank = first; rank < last; ++rank) {
+                    current[rank] = solver.solve(idx, [&] (unsigned long nextIdx) -> int
+                        { return below[combination_rank(nextIdx)].second; });
+
+                    print_solved(oldboard, solver, idx, current[rank]);
+
+                    if (rank + 1 < last)
+                        idx = next_combination_mask(idx);
+                }
+            },
+            [&] (int level)
+            {
+                int k = nedges - 1 - level;
+                write_level(dir, oldboard, k, current);
+                progress.level_done(k, current.size());
+
+                below.swap(current);
+                std::vector<std::pair<Edge, short>>().swap(current);
+                if (k > 0)
+                    current.resize(binomial(nedges, k - 1));
+            });
+
+    progress.finished(below[0].second);
+}
+
+// runs the brute force mode picked on the command line with the solver
+// specialized for the board's geometry
+struct BruteForceRun
+{
+    Board board;
+    bool symmetric, packed;
+    int nthreads;
+    const char *level_dir, *tablebase;
+
+    template<class Geometry>
+    void operator()(const Geometry &geometry) const
+    {
+        PositionSolver<Geometry> solver(board, geometry);
+        unsigned long size = ((unsigned long)1) << solver.num_edges();
+        int nboxes = board.get_width() * board.get_height();
+
+        if (symmetric)
+            brute_force_symmetric(board, solver, nthreads);
+        else if (level_dir)
+            brute_force_streamed(board, solver, nthreads, level_dir);
+        else if (packed) {
+            PackedScoreTable table(nboxes, size);
+            brute_force(board, solver, table, nthreads);
+            if (tablebase)
+                write_tablebase(tablebase, board, table);
+        } else {
+            DenseTable table(size);
+            brute_force(board, solver, table, nthreads);
+            if (tablebase) {
+                PackedTable packed_table(nboxes, size);
+                for (unsigned long idx = 0; idx < size; ++idx)
+                    packed_table.set(idx, table.score(idx));
+                write_tablebase(tablebase, board, packed_table);
+            }
+        }
+    }
+};
+
+// solves the board with a ParallelSearch, which needs no table and so works
+// for boards too big to have one
+static void search_solve(const Board &board, int nthreads)
+{
+    Progress progress(0);
+    ParallelSearch search(board, nthreads);
+    std::pair<Edge, short> solved = search.solve(-1);
+
+    if (!quiet) {
+        board.print(stdout);
+        solved.first.print(stdout);
+        printf("searched %lu positions, expect to win by: %d\n", search.num_nodes(), solved.second);
     }
+    progress.finished(solved.second);
+}
 
-    do_brute_force_one_level(oldboard, table, edges.begin(), edges.begin(), edges.end());
+static Board read_board_file(const char *path)
+{
+    FILE *fp = fopen(path, "r");
+    if (!fp) {
+        perror(path);
+        exit(1);
+    }
+    Board board = read_board(fp);
+    fclose(fp);
+    return board;
 }
 
 int main(int argc, char **argv)
 {
-    if (argc < 3)
+    bool symmetric = false, packed = false, search = false;
+    int nthreads = 1;
+    const char *level_dir = NULL, *tablebase = NULL, *board_file = NULL;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "spyqj:l:o:b:")) != -1) {
+        switch (opt) {
+            case 's': symmetric = true; break;
+            case 'p': packed = true; break;
+            case 'y': search = true; break;
+            case 'q': quiet = true; break;
+            case 'j': nthreads = atoi(optarg); break;
+            case 'l': level_dir = optarg; break;
+            case 'o': tablebase = optarg; break;
+            case 'b': board_file = optarg; break;
+            default: usage();
+        }
+    }
+
+    // symmetries and tablebases are for the whole board
+    if (nthreads < 1 || symmetric + packed + search + (level_dir != NULL) > 1 ||
+            (tablebase && (symmetric || search || level_dir)) ||
+            (board_file && (symmetric || tablebase)))
+        usage();
+
+    if (argc - optind < (board_file ? 0 : 2))
         usage();
 
-    int width = atoi(argv[1]);
-    int height = atoi(argv[2]);
+    Board board = board_file ? read_board_file(board_file) :
+        Board(atoi(argv[optind]), atoi(argv[optind + 1]));
+    int width = board.get_width();
+    int height = board.get_height();
+
+    if (search) {
+        // the transposition table keeps depths in a signed char
+        if (board.num_free_edges() > 127) {
+            fprintf(stderr, "The %dx%d board has %d free edges, search only solves boards with at most 127\n",
+                    width, height, board.num_free_edges());
+            exit(1);
+        }
+        search_solve(board, nthreads);
+        return 0;
+    }
+
+    // positions are indexed by a one word mask of their filled edges
+    if (board.num_free_edges() >= 64) {
+        fprintf(stderr, "The %dx%d board has %d free edges, brute force only solves boards with less than 64\n",
+                width, height, board.num_free_edges());
+        exit(1);
+    }
 
-    Board board(width, height);
-    brute_force(board);
+    BruteForceRun run = {board, symmetric, packed, nthreads,
+        level_dir, tablebase};
+    if (board_file)
+        run(PartialGeometry(board));
+    else
+        with_geometry(width, height, run);
 }
@@ -15,7 +15,9 @@
 
 static void usage()
 {
-    printf("USAGE: ./dots <width> <height> <player1> <player2>\n");
+    printf("USAGE: ./dots [-s seed] <width> <height> <player1> <player2>\n");
+    printf("  -s: seed the players' random numbers, player 1 with seed and\n"
+           "      player 2 with seed + 1, so games can be replayed\n");
 
     exit(1);
 }
@@ -23,15 +25,25 @@ static void usage()
 static std::string command[2];
 static int width, height;
 
+static const char *seed;
+
 static void parseArgs(int argc, char **argv)
 {
-    if (argc < 5)
+    int opt;
+    while ((opt = getopt(argc, argv, "s:")) != -1) {
+        switch (opt) {
+            case 's': seed = optarg; break;
+            default: usage();
+        }
+    }
+
+    if (argc - optind < 4)
         usage();
 
-    width = atoi(argv[1]);
-    height = atoi(argv[2]);
-    command[0] = argv[3];
-    command[1] = argv[4];
+    width = atoi(argv[optind]);
+    height = atoi(argv[optind + 1]);
+    command[0] = argv[optind + 2];
+    command[1] = argv[optind + 3];
 }
 
 void move_fd(int oldfd, int newfd)
@@ -125,6 +137,14 @@ int main(int argc, char **argv)
     pid_t player_pid[2];
 
     for (int player = 0; player <= 1; ++player) {
+        // the players read it from the environment they inherit
+        if (seed) {
+            char player_seed[32];
+            snprintf(player_seed, sizeof(player_seed), "%llu",
+                    strtoull(seed, NULL, 0) + player);
+            setenv("DOTS_SEED", player_seed, 1);
+        }
+
         spawn_child(command[player].c_str(), player_stdin[player],
                 player_stdout[player], player_stderr[player],
                 player_pid[player]);
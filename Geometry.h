@@ -0,0 +1,234 @@
+#ifndef GEOMETRY_H
+#define GEOMETRY_H
+
+#include "Board.h"
+
+#include <algorithm>
+#include <vector>
+#include <stdint.h>
+
+// Board adjacency as edge_index bitmasks: for every edge the edge masks of
+// the boxes on either side of it (the first is never 0, the second is 0 for
+// edges on the border), and for every box the mask of its four edges.
+//
+// BoardGeometry<W, H> has the tables built at compile time so loops over
+// them unroll and fold for that size. DynamicGeometry has the same interface
+// for every other size. with_geometry() picks the right one for a board.
+// PartialGeometry numbers only the free edges of a position, for solving
+// from there on boards of any size.
+
+template<int... I> struct IndexList {};
+
+template<int N, int... I>
+struct MakeIndexList : MakeIndexList<N - 1, N - 1, I...> {};
+
+template<int... I>
+struct MakeIndexList<0, I...>
+{
+    typedef IndexList<I...> type;
+};
+
+template<int W, int H>
+struct GeometryMath
+{
+    static constexpr int num_horiz() { return W * (H + 1); }
+    static constexpr int num_edges() { return W * (H + 1) + H * (W + 1); }
+
+    static constexpr uint64_t bit(int i) { return ((uint64_t)1) << i; }
+
+    static constexpr uint64_t box_mask(int x, int y)
+    {
+        return bit(y * W + x) | bit((y + 1) * W + x) |
+            bit(num_horiz() + y * (W + 1) + x) |
+            bit(num_horiz() + y * (W + 1) + x + 1);
+    }
+
+    // the boxes above and below horizontal edge i, or left and right of
+    // vertical edge i, 0 where there is none
+    static constexpr uint64_t before(int i)
+    {
+        return i < num_horiz() ?
+            (i / W > 0 ? box_mask(i % W, i / W - 1) : 0) :
+            ((i - num_horiz()) % (W + 1) > 0 ?
+             box_mask((i - num_horiz()) % (W + 1) - 1, (i - num_horiz()) / (W + 1)) : 0);
+    }
+
+    static constexpr uint64_t after(int i)
+    {
+        return i < num_horiz() ?
+            (i / W < H ? box_mask(i % W, i / W) : 0) :
+            ((i - num_horiz()) % (W + 1) < W ?
+             box_mask((i - num_horiz()) % (W + 1), (i - num_horiz()) / (W + 1)) : 0);
+    }
+
+    static constexpr uint64_t edge_box(int i, int side)
+    {
+        return side == 0 ? (before(i) ? before(i) : after(i)) :
+            (before(i) ? after(i) : 0);
+    }
+};
+
+template<int W, int H, class Indices>
+struct GeometryTables;
+
+template<int W, int H, int... I>
+struct GeometryTables<W, H, IndexList<I...>>
+{
+    static constexpr uint64_t edge_boxes[sizeof...(I)] =
+        { GeometryMath<W, H>::edge_box(I / 2, I % 2)... };
+};
+
+template<int W, int H, int... I>
+constexpr uint64_t GeometryTables<W, H, IndexList<I...>>::edge_boxes[sizeof...(I)];
+
+template<int W, int H>
+class BoardGeometry
+{
+    public:
+        typedef GeometryTables<W, H,
+                typename MakeIndexList<2 * GeometryMath<W, H>::num_edges()>::type> Tables;
+
+        static constexpr int width() { return W; }
+        static constexpr int height() { return H; }
+        static constexpr int num_edges() { return GeometryMath<W, H>::num_edges(); }
+
+        static constexpr uint64_t edge_box(int i, int side)
+        { return Tables::edge_boxes[2 * i + side]; }
+        static constexpr uint64_t box_mask(int x, int y)
+        { return GeometryMath<W, H>::box_mask(x, y); }
+};
+
+class DynamicGeometry
+{
+    public:
+        DynamicGeometry(int width, int height);
+
+        int width() const { return w; }
+        int height() const { return h; }
+        int num_edges() const { return nedges; }
+
+        uint64_t edge_box(int i, int side) const { return edge_boxes[2 * i + side]; }
+        uint64_t box_mask(int x, int y) const { return box_masks[y * w + x]; }
+
+    private:
+        int w, h, nedges;
+        std::vector<uint64_t> edge_boxes, box_masks;
+};
+
+inline DynamicGeometry::DynamicGeometry(int width, int height) :
+    w(width), h(height), nedges(Board(width, height).num_edges()),
+    edge_boxes(2 * nedges, 0), box_masks(width * height, 0)
+{
+    Board empty(width, height);
+
+    empty.for_each_node([&] (Node node)
+            {
+                uint64_t &mask = this->box_masks[node.y * width + node.x];
+                empty.for_each_adjacent_edge(node, [&] (Edge edge)
+                    { mask |= ((uint64_t)1) << empty.edge_index(edge); });
+            });
+
+    std::for_each(empty.edge_begin(), empty.edge_end(), [&] (Edge edge)
+            {
+                if (!empty.is_move_valid(edge))
+                    return;
+                uint64_t *box = &this->edge_boxes[2 * empty.edge_index(edge)];
+                empty.for_each_adjacent_node(edge, [&] (Node node)
+                    { *box++ = this->box_masks[node.y * width + node.x]; });
+            });
+}
+
+// the free edges of board in edge_index order, which is the order a
+// geometry numbers them in
+inline std::vector<Edge> free_edges(const Board &board)
+{
+    std::vector<Edge> by_index(board.num_edges());
+    std::vector<bool> free(board.num_edges(), false);
+    std::for_each(board.edge_begin(), board.edge_end(), [&] (Edge edge)
+            {
+                if (board.is_move_valid(edge)) {
+                    by_index[board.edge_index(edge)] = edge;
+                    free[board.edge_index(edge)] = true;
+                }
+            });
+
+    std::vector<Edge> edges;
+    for (int i = 0; i < board.num_edges(); ++i) {
+        if (free[i])
+            edges.push_back(by_index[i]);
+    }
+    return edges;
+}
+
+// The adjacency of a position's free edges, numbered from 0 in edge_index
+// order. A box's mask only has its free edges, so it is full once they are
+// all filled. There have to be less than 64.
+class PartialGeometry
+{
+    public:
+        PartialGeometry(const Board &board);
+
+        int width() const { return w; }
+        int height() const { return h; }
+        int num_edges() const { return nedges; }
+
+        uint64_t edge_box(int i, int side) const { return edge_boxes[2 * i + side]; }
+
+    private:
+        int w, h, nedges;
+        std::vector<uint64_t> edge_boxes;
+};
+
+inline PartialGeometry::PartialGeometry(const Board &board) :
+    w(board.get_width()), h(board.get_height()), nedges(0)
+{
+    std::vector<Edge> edges = free_edges(board);
+    nedges = edges.size();
+    edge_boxes.assign(2 * nedges, 0);
+
+    std::vector<int> number(board.num_edges(), -1);
+    for (int i = 0; i < nedges; ++i)
+        number[board.edge_index(edges[i])] = i;
+
+    for (int i = 0; i < nedges; ++i) {
+        uint64_t *box = &edge_boxes[2 * i];
+        board.for_each_adjacent_node(edges[i], [&] (Node node)
+                {
+                    uint64_t mask = 0;
+                    board.for_each_adjacent_edge(node, [&] (Edge edge)
+                        {
+                            if (board.is_move_valid(edge))
+                                mask |= ((uint64_t)1) << number[board.edge_index(edge)];
+                        });
+                    *box++ = mask;
+                });
+    }
+}
+
+// calls f(geometry) with a BoardGeometry for the sizes small enough to solve
+// by brute force, and a DynamicGeometry for the rest
+template<class F>
+void with_geometry(int width, int height, F &f)
+{
+#define GEOMETRY_CASE(W, H) \
+    if (width == W && height == H) { \
+        f(BoardGeometry<W, H>()); \
+        return; \
+    }
+
+    GEOMETRY_CASE(1, 1)
+    GEOMETRY_CASE(2, 1)
+    GEOMETRY_CASE(1, 2)
+    GEOMETRY_CASE(2, 2)
+    GEOMETRY_CASE(3, 2)
+    GEOMETRY_CASE(2, 3)
+    GEOMETRY_CASE(3, 3)
+    GEOMETRY_CASE(4, 3)
+    GEOMETRY_CASE(3, 4)
+
+#undef GEOMETRY_CASE
+
+    f(DynamicGeometry(width, height));
+}
+
+#endif
@@ -66,7 +66,7 @@ void Board::print_horiz_edges(int y, FILE *fp) const
 {
     fprintf(fp, "+");
     for (int x = 0; x < width; ++x) {
-        if (edges[edge_index(Edge(HORIZ, x, y))])
+        if (is_filled(Edge(HORIZ, x, y)))
             fprintf(fp, "-+");
         else
             fprintf(fp, " +");
@@ -77,7 +77,7 @@ void Board::print_horiz_edges(int y, FILE *fp) const
 void Board::print_vert_edges(int y, FILE *fp) const
 {
     for (int x = 0; x < width; ++x) {
-        if (edges[edge_index(Edge(VERT, x, y))])
+        if (is_filled(Edge(VERT, x, y)))
             fprintf(fp, "|");
         else
             fprintf(fp, " ");
@@ -88,7 +88,7 @@ void Board::print_vert_edges(int y, FILE *fp) const
             fprintf(fp, " ");
     }
 
-    if (edges[edge_index(Edge(VERT, width, y))])
+    if (is_filled(Edge(VERT, width, y)))
         fprintf(fp, "|\n");
     else
         fprintf(fp, " \n");
@@ -128,7 +128,7 @@ void Board::read_horiz_edges(int y, FILE *fp)
                             x, width);
                     exit(1);
                 }
-                edges[edge_index(Edge(HORIZ, x, y))] = true;
+                set_filled(Edge(HORIZ, x, y), true);
                 ++x;
                 break;
             case ' ':
@@ -137,7 +137,7 @@ void Board::read_horiz_edges(int y, FILE *fp)
                             x, width);
                     exit(1);
                 }
-                edges[edge_index(Edge(HORIZ, x, y))] = false;
+                set_filled(Edge(HORIZ, x, y), false);
                 ++x;
                 break;
             default:
@@ -172,7 +172,7 @@ void Board::read_vert_edges(int y, FILE *fp)
                             x, width, y);
                     exit(1);
                 }
-                edges[edge_index(Edge(VERT, x, y))] = true;
+                set_filled(Edge(VERT, x, y), true);
                 ++x;
                 break;
             case ' ':
@@ -183,7 +183,7 @@ void Board::read_vert_edges(int y, FILE *fp)
                 }
 
                 if (!reading_cell) {
-                    edges[edge_index(Edge(VERT, x, y))] = false;
+                    set_filled(Edge(VERT, x, y), false);
                     ++x;
                 }
                 break;
@@ -206,12 +206,13 @@ Board read_board(FILE *fp)
 {
     Board board;
 
-    fscanf(fp, "%d %d %d %d\n", &board.height, &board.width,
+    fscanf(fp, "%d %d %d %d\n", &board.width, &board.height,
             &board.score[0], &board.score[1]);
     if (feof(fp))
         exit(0);
 
-    board.edges.assign(board.width * (board.height + 1) + board.height * (board.width + 1), false);
+    board.check_size();
+    board.resize();
 
     for (int y = 0; y < board.height; ++y) {
         board.read_horiz_edges(y, fp);
@@ -222,6 +223,8 @@ Board read_board(FILE *fp)
     if (feof(fp))
         exit(0);
 
+    board.recount();
+
     return board;
 }
 
@@ -0,0 +1,96 @@
+#include "MacroMoves.h"
+
+// the box a capture edge takes and the box on its other side, which has to
+// have two sides filled
+static bool capture_ends(const Board &board, Edge edge, Node &taken, Node &next)
+{
+    Node nodes[2];
+    int n = 0;
+    board.for_each_adjacent_node(edge, [&] (Node node) { nodes[n++] = node; });
+    if (n < 2)
+        return false;
+
+    for (int k = 0; k < 2; ++k) {
+        if (board.degree(nodes[k]) == 3 && board.degree(nodes[!k]) == 2) {
+            taken = nodes[k];
+            next = nodes[!k];
+            return true;
+        }
+    }
+    return false;
+}
+
+int double_deal_edge(const Board &board)
+{
+    int ncaptures = board.num_moves(MOVE_CAPTURE);
+    Node taken, next;
+
+    if (ncaptures == 1) {
+        Edge capture = board.nth_move(MOVE_CAPTURE, 0);
+        if (!capture_ends(board, capture, taken, next))
+            return -1;
+
+        Edge deal = capture;
+        board.for_each_adjacent_edge(next, [&] (Edge edge)
+                { if (board.is_move_valid(edge) && edge != capture) deal = edge; });
+
+        // unless the chain goes on past next
+        bool tail = true;
+        board.for_each_adjacent_node(deal, [&] (Node node)
+                { if (node != next && board.degree(node) == 2) tail = false; });
+        return tail ? board.edge_index(deal) : -1;
+    }
+
+    if (ncaptures == 2) {
+        Edge capture[2] = {board.nth_move(MOVE_CAPTURE, 0), board.nth_move(MOVE_CAPTURE, 1)};
+        Node other_taken, other_next;
+        if (!capture_ends(board, capture[0], taken, next) ||
+                !capture_ends(board, capture[1], other_taken, other_next) ||
+                next == other_next)
+            return -1;
+
+        // the edge between the two boxes left in the middle
+        int deal = -1;
+        board.for_each_adjacent_edge(next, [&] (Edge edge)
+                {
+                    if (!board.is_move_valid(edge))
+                        return;
+                    board.for_each_adjacent_node(edge, [&] (Node node)
+                        { if (node == other_next) deal = board.edge_index(edge); });
+                });
+        return deal;
+    }
+
+    return -1;
+}
+
+int play_captures(Board &board, bool double_deal, short *played)
+{
+    int nplayed = 0;
+    while (board.num_moves(MOVE_CAPTURE) > 0) {
+        if (double_deal) {
+            int deal = double_deal_edge(board);
+            if (deal >= 0) {
+                board.move(0, board.edge_at(deal));
+                played[nplayed++] = deal;
+                return nplayed;
+            }
+        }
+
+        Edge edge = board.nth_move(MOVE_CAPTURE, 0);
+        board.move(0, edge);
+        played[nplayed++] = board.edge_index(edge);
+    }
+
+    if (double_deal) {
+        undo_captures(board, played, nplayed);
+        return -1;
+    }
+    return nplayed;
+}
+
+void undo_captures(Board &board, const short *played, int nplayed)
+{
+    for (int i = nplayed - 1; i >= 0; --i)
+        board.unmove(0, board.edge_at(played[i]));
+}
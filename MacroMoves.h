@@ -0,0 +1,31 @@
+#ifndef MACRO_MOVES_H
+#define MACRO_MOVES_H
+
+#include "Board.h"
+
+// Where boxes can be taken a search needn't branch on single captures, only
+// on two macro moves: take everything (and move again), or take all but the
+// last two boxes of a chain (four of an opened loop) and hand those over with
+// a double-dealing move. Either way it counts as one ply. Moves in the
+// searches are edge_indexes or one of these.
+enum
+{
+    TAKE_ALL = -2,
+    DOUBLE_DEAL = -3
+};
+
+// the edge that hands the opponent the last two boxes of a chain, or the
+// last four of an opened loop, when those are all that is left to take. -1
+// if there is none
+int double_deal_edge(const Board &board);
+
+// takes boxes until there are none left, writing the edge_indexes played to
+// played and returning how many. With double_deal it stops where
+// double_deal_edge() finds a move and plays that instead; if it never does
+// everything is taken back and it returns -1
+int play_captures(Board &board, bool double_deal, short *played);
+
+// takes back the edges play_captures played
+void undo_captures(Board &board, const short *played, int nplayed);
+
+#endif
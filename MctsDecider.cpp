@@ -0,0 +1,316 @@
+#include "Board.h"
+#include "Random.h"
+#include "StringsAndCoins.h"
+
+#include <vector>
+#include <cmath>
+#include <cstdlib>
+#include <stdint.h>
+
+#include <sys/time.h>
+#include <pthread.h>
+#include <unistd.h>
+
+// Monte Carlo tree search with UCT. Every thread walks the same tree; the
+// counters are updated with atomic adds, and a thread passing through a node
+// adds VIRTUAL_LOSS visits that lost every box to it until its rollout is
+// back, which steers the other threads down different paths meanwhile.
+//
+// Random play throws the chain endgame away, so a rollout only plays nocheap
+// until the position is loony (no safe moves left and nothing to take) and
+// then scores it with the exact StringsAndCoins value when it is simple,
+// which it nearly always is by then. The tree leaves sacrifices out while
+// there are safe moves, and a capture that can't be part of a double deal is
+// a node's only child; both let it look deeper where the game is decided.
+//
+// Nodes are rated by the final score difference rather than by wins, so the
+// search still fights for every box in games that are already decided.
+
+struct MctsNode
+{
+    int move; // edge_index of the move into this node
+    int player; // who made that move
+    int first_child, nchildren;
+    int state; // LEAF, EXPANDING or EXPANDED
+    int visits;
+    int64_t score_sum; // final score differences for player
+};
+
+enum
+{
+    LEAF,
+    EXPANDING,
+    EXPANDED
+};
+
+static const int VIRTUAL_LOSS = 1;
+static const double EXPLORATION = 0.7;
+// more than a second of search fills this on the boards we play, once it is
+// full the leaves just stop growing
+static const int POOL_NODES = 1 << 21;
+// value() is exponential in the components, past this many the rollout plays
+// them out instead
+static const int EXACT_COMPONENTS = 12;
+
+class MctsSearch
+{
+    public:
+        MctsSearch(const Board &board, int budget_ms, int nthreads);
+
+        Edge search();
+
+    private:
+        static void *run_thread(void *arg);
+        void run(Random &random);
+        int select_child(const MctsNode &node) const;
+        void expand(MctsNode &node, const Board &board, int player);
+        int rollout(Board &board, int player, Random &random) const;
+        bool out_of_time() const;
+
+        const Board &root_board;
+        int nboxes;
+        MctsNode *nodes;
+        int nnodes; // nodes used, grows atomically
+        int nthreads;
+        timeval deadline;
+        volatile bool stop;
+};
+
+static void add_visits(MctsNode &node, int visits, int64_t score)
+{
+    __sync_add_and_fetch(&node.visits, visits);
+    __sync_add_and_fetch(&node.score_sum, score);
+}
+
+MctsSearch::MctsSearch(const Board &board, int budget_ms, int nthreads) :
+    root_board(board), nboxes(board.get_width() * board.get_height()),
+    nthreads(nthreads), stop(false)
+{
+    gettimeofday(&deadline, NULL);
+    deadline.tv_sec += budget_ms / 1000;
+    deadline.tv_usec += budget_ms % 1000 * 1000;
+    if (deadline.tv_usec >= 1000000) {
+        ++deadline.tv_sec;
+        deadline.tv_usec -= 1000000;
+    }
+
+    // one pool for every move the process makes, left uninitialised so only
+    // the nodes a search uses are ever touched; expand writes them whole
+    static MctsNode *pool = new MctsNode[POOL_NODES];
+    nodes = pool;
+    MctsNode root = {-1, 1, 0, 0, LEAF, 0, 0};
+    nodes[0] = root;
+    nnodes = 1;
+}
+
+bool MctsSearch::out_of_time() const
+{
+    timeval now;
+    gettimeofday(&now, NULL);
+    return now.tv_sec > deadline.tv_sec ||
+        (now.tv_sec == deadline.tv_sec && now.tv_usec >= deadline.tv_usec);
+}
+
+// the child with the best upper confidence bound, unvisited children first
+int MctsSearch::select_child(const MctsNode &node) const
+{
+    double log_visits = log((double)std::max(node.visits, 1));
+    int best = node.first_child;
+    double best_bound = -HUGE_VAL;
+    for (int i = node.first_child; i < node.first_child + node.nchildren; ++i) {
+        const MctsNode &child = nodes[i];
+        int visits = child.visits;
+        if (visits == 0)
+            return i;
+        double bound = (double)child.score_sum / ((double)visits * nboxes) +
+            EXPLORATION * sqrt(log_visits / visits);
+        if (bound > best_bound) {
+            best_bound = bound;
+            best = i;
+        }
+    }
+    return best;
+}
+
+// a capture that can't be part of a double deal, because the box on the
+// other side of it is the ground or doesn't become takeable, is always worth
+// taking right away. -1 if there is none
+static int forced_capture(const Board &board)
+{
+    int forced = -1;
+    board.for_each_move(MOVE_CAPTURE, [&] (Edge edge)
+            {
+                if (forced >= 0)
+                    return;
+                bool chain = false;
+                board.for_each_adjacent_node(edge, [&] (Node node)
+                    { if (board.degree(node) == 2) chain = true; });
+                if (!chain)
+                    forced = board.edge_index(edge);
+            });
+    return forced;
+}
+
+void MctsSearch::expand(MctsNode &node, const Board &board, int player)
+{
+    int forced = forced_capture(board);
+    bool safe = board.num_moves(MOVE_SAFE) > 0;
+    int nmoves = forced >= 0 ? 1 :
+        safe ? board.num_moves(MOVE_SAFE) + board.num_moves(MOVE_CAPTURE) :
+        board.num_moves();
+
+    int first = __sync_fetch_and_add(&nnodes, nmoves);
+    if (first + nmoves > POOL_NODES) {
+        // out of nodes, it stays a leaf
+        node.state = LEAF;
+        return;
+    }
+
+    int i = first;
+    auto add = [&] (Edge edge)
+            {
+                MctsNode child = {board.edge_index(edge), player, 0, 0, LEAF, 0, 0};
+                this->nodes[i++] = child;
+            };
+    if (forced >= 0) {
+        add(board.edge_at(forced));
+    } else if (safe) {
+        board.for_each_move(MOVE_CAPTURE, add);
+        board.for_each_move(MOVE_SAFE, add);
+    } else {
+        board.for_each_move(add);
+    }
+
+    node.first_child = first;
+    node.nchildren = nmoves;
+    __sync_synchronize();
+    node.state = EXPANDED;
+}
+
+// the final score difference for player, who is to move
+int MctsSearch::rollout(Board &board, int player, Random &random) const
+{
+    int mover = player;
+    bool loony = false;
+    while (!board.is_game_over()) {
+        Edge edge;
+        if (board.num_moves(MOVE_CAPTURE) > 0) {
+            edge = board.nth_move(MOVE_CAPTURE, 0);
+        } else if (board.num_moves(MOVE_SAFE) > 0) {
+            edge = board.nth_move(MOVE_SAFE, random.below(board.num_moves(MOVE_SAFE)));
+        } else {
+            if (!loony) {
+                loony = true;
+                StringsAndCoins coins(board);
+                if (coins.is_simple() && (int)coins.components().size() <= EXACT_COMPONENTS) {
+                    int value = coins.value();
+                    int lead = board.get_score(mover) - board.get_score(!mover);
+                    return mover == player ? lead + value : -(lead + value);
+                }
+            }
+            edge = board.nth_move(MOVE_SACRIFICE, random.below(board.num_moves(MOVE_SACRIFICE)));
+        }
+        if (!board.move(mover, edge))
+            mover = !mover;
+    }
+    return board.get_score(player) - board.get_score(!player);
+}
+
+void MctsSearch::run(Random &random)
+{
+    std::vector<int> path;
+
+    for (int iteration = 0; !stop; ++iteration) {
+        if ((iteration & 15) == 0 && out_of_time())
+            stop = true;
+
+        Board board = root_board;
+        int player = 0;
+        path.assign(1, 0);
+        add_visits(nodes[0], VIRTUAL_LOSS, -VIRTUAL_LOSS * nboxes);
+
+        while (nodes[path.back()].state == EXPANDED && !board.is_game_over()) {
+            int i = select_child(nodes[path.back()]);
+            add_visits(nodes[i], VIRTUAL_LOSS, -VIRTUAL_LOSS * nboxes);
+            path.push_back(i);
+            if (!board.move(player, board.edge_at(nodes[i].move)))
+                player = !player;
+        }
+
+        // grow the tree by one level below leaves that have been seen before
+        MctsNode &leaf = nodes[path.back()];
+        if (leaf.visits > VIRTUAL_LOSS && !board.is_game_over() &&
+                __sync_bool_compare_and_swap(&leaf.state, LEAF, EXPANDING))
+            expand(leaf, board, player);
+
+        int64_t score = rollout(board, player, random);
+
+        // replace the virtual losses with the result, from the point of view
+        // of whoever moved into each node
+        for (size_t k = 0; k < path.size(); ++k) {
+            MctsNode &node = nodes[path[k]];
+            add_visits(node, 1 - VIRTUAL_LOSS,
+                    (node.player == player ? score : -score) +
+                    VIRTUAL_LOSS * nboxes);
+        }
+    }
+}
+
+struct MctsThread
+{
+    MctsSearch *search;
+    Random random;
+};
+
+void *MctsSearch::run_thread(void *arg)
+{
+    MctsThread *thread = (MctsThread *)arg;
+    thread->search->run(thread->random);
+    return NULL;
+}
+
+// plays the root's most visited move
+Edge MctsSearch::search()
+{
+    if (root_board.num_moves() == 1)
+        return root_board.nth_move(MOVE_ANY, 0);
+
+    std::vector<MctsThread> threads(nthreads, MctsThread{this, Random(0)});
+    for (int t = 0; t < nthreads; ++t)
+        threads[t].random.seed(process_random().next());
+
+    std::vector<pthread_t> ids(nthreads);
+    for (int t = 1; t < nthreads; ++t)
+        pthread_create(&ids[t], NULL, &MctsSearch::run_thread, &threads[t]);
+    run(threads[0].random);
+    for (int t = 1; t < nthreads; ++t)
+        pthread_join(ids[t], NULL);
+
+    const MctsNode &root = nodes[0];
+    if (root.state != EXPANDED)
+        return root_board.nth_move(MOVE_ANY, 0);
+
+    int best = root.first_child;
+    for (int i = root.first_child; i < root.first_child + root.nchildren; ++i) {
+        if (nodes[i].visits > nodes[best].visits)
+            best = i;
+    }
+    return root_board.edge_at(nodes[best].move);
+}
+
+// searches for DOTS_SEARCH_MS milliseconds (800 by default, leaving the
+// driver's one second limit room for a loaded machine) on DOTS_THREADS
+// threads (one per core by default). Once no safe moves are left the game is
+// a chain endgame, which the negamax search solves outright
+Edge Board::decide_move_mcts()
+{
+    if (num_moves(MOVE_SAFE) == 0)
+        return decide_move_negamax();
+
+    const char *budget = getenv("DOTS_SEARCH_MS");
+    const char *threads = getenv("DOTS_THREADS");
+    int nthreads = threads ? atoi(threads) : sysconf(_SC_NPROCESSORS_ONLN);
+
+    MctsSearch search(*this, budget ? atoi(budget) : 800, std::max(nthreads, 1));
+    return search.search();
+}
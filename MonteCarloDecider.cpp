@@ -0,0 +1,84 @@
+#include "Board.h"
+#include "Playout.h"
+#include "Random.h"
+
+#include <string>
+#include <vector>
+#include <cstdlib>
+
+#include <sys/time.h>
+
+static long elapsed_ms(const timeval &start)
+{
+    timeval now;
+    gettimeofday(&now, NULL);
+    return (now.tv_sec - start.tv_sec) * 1000 + (now.tv_usec - start.tv_usec) / 1000;
+}
+
+// flat Monte Carlo: shares DOTS_SEARCH_MS milliseconds (800 by default) of
+// random playouts evenly between the moves and plays the one with the best
+// average score difference. The moves take turns at one batch of LANES
+// playouts each, in a random order, with the clock checked after every batch
+// so a big board's moves can't run past the budget; if it runs out before
+// every move has had a batch only the ones that did are compared.
+// DOTS_PLAYOUT=uniform plays uniformly random playouts instead of nocheap.
+Edge Board::decide_move_montecarlo()
+{
+    timeval start;
+    gettimeofday(&start, NULL);
+
+    const char *budget_env = getenv("DOTS_SEARCH_MS");
+    long budget = budget_env ? atol(budget_env) : 800;
+    const char *policy_env = getenv("DOTS_PLAYOUT");
+    PlayoutPolicy policy = policy_env && std::string(policy_env) == "uniform" ?
+        PLAYOUT_UNIFORM : PLAYOUT_NOCHEAP;
+
+    static const int BATCH = PlayoutEngine::LANES;
+    PlayoutEngine engine(width, height);
+    Random &random = process_random();
+
+    // the position after each move, and what it is worth before the playouts
+    std::vector<Edge> moves;
+    std::vector<Board> children;
+    std::vector<int> took;
+    for_each_move([&] (Edge edge)
+            {
+                Board child = *this;
+                int oldscore = child.get_score(0);
+                bool again = child.move(0, edge);
+                moves.push_back(edge);
+                children.push_back(child);
+                took.push_back(again ? child.get_score(0) - oldscore : -1);
+            });
+
+    std::vector<size_t> turns(moves.size());
+    for (size_t i = 0; i < turns.size(); ++i) {
+        size_t j = random.below(i + 1);
+        turns[i] = turns[j];
+        turns[j] = i;
+    }
+
+    std::vector<long> score_diffs(moves.size(), 0), playouts(moves.size(), 0);
+    for (size_t turn = 0; turn == 0 || elapsed_ms(start) < budget; ++turn) {
+        size_t i = turns[turn % turns.size()];
+        PlayoutEngine::Result result = engine.run(children[i], BATCH, random, 0, policy);
+        score_diffs[i] += result.score_diff;
+        playouts[i] += result.playouts;
+    }
+
+    // after a move that takes nothing the playouts are for the opponent
+    size_t best = moves.size();
+    double best_value = 0;
+    for (size_t i = 0; i < moves.size(); ++i) {
+        if (playouts[i] == 0)
+            continue;
+        double mean = (double)score_diffs[i] / playouts[i];
+        double value = took[i] >= 0 ? took[i] + mean : -mean;
+        if (best == moves.size() || value > best_value) {
+            best = i;
+            best_value = value;
+        }
+    }
+
+    return moves[best];
+}
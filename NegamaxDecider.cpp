@@ -0,0 +1,284 @@
+#include "Board.h"
+#include "MacroMoves.h"
+#include "StringsAndCoins.h"
+#include "TranspositionTable.h"
+
+#include <algorithm>
+#include <cassert>
+#include <vector>
+#include <climits>
+#include <cstdlib>
+#include <stdint.h>
+
+#include <sys/time.h>
+
+// Iterative deepening alpha-beta search. Values are the score difference the
+// player to move can expect from the rest of the game, so a move that takes a
+// box adds the boxes taken to the value of the same player moving again and
+// any other move negates the opponent's value.
+// Where boxes can be taken it only branches on the two macro moves.
+
+class NegamaxSearch
+{
+    public:
+        NegamaxSearch(const Board &board, int budget_ms);
+
+        Edge search();
+
+    private:
+        int negamax(int depth, int alpha, int beta);
+        int try_move(int move, int depth, int alpha, int beta);
+        int evaluate() const;
+        int order_moves(short *moves, int tt_move) const;
+        Edge first_edge(int move);
+        bool out_of_time();
+
+        Board board;
+        std::vector<Edge> edges; // by edge_index
+        // num_edges() moves for each depth, and the edges a macro move played
+        std::vector<short> move_stack, played_stack;
+
+        timeval deadline;
+        unsigned long nodes;
+        bool aborted;
+};
+
+static int tt_width = -1, tt_height = -1;
+
+NegamaxSearch::NegamaxSearch(const Board &board, int budget_ms) :
+    board(board), edges(board.num_edges()), nodes(0), aborted(false)
+{
+    // the clock starts before any of the setup
+    gettimeofday(&deadline, NULL);
+    deadline.tv_sec += budget_ms / 1000;
+    deadline.tv_usec += budget_ms % 1000 * 1000;
+    if (deadline.tv_usec >= 1000000) {
+        ++deadline.tv_sec;
+        deadline.tv_usec -= 1000000;
+    }
+
+    Board empty(board.get_width(), board.get_height());
+    std::for_each(empty.edge_begin(), empty.edge_end(), [&] (Edge edge)
+            {
+                if (empty.is_move_valid(edge))
+                    this->edges[empty.edge_index(edge)] = edge;
+            });
+
+    // entries stay useful from one move to the next, but not across sizes
+    if (tt_width == -1) {
+        // a new table is already empty
+        tt_width = board.get_width();
+        tt_height = board.get_height();
+    } else if (tt_width != board.get_width() || tt_height != board.get_height()) {
+        process_tt().clear();
+        tt_width = board.get_width();
+        tt_height = board.get_height();
+    } else {
+        process_tt().new_search();
+    }
+
+}
+
+// counts every node, leaves too, and looks at the clock every 64 of them:
+// on a large board each one scans every box, so a wider interval would
+// overrun the driver's deadline
+bool NegamaxSearch::out_of_time()
+{
+    if (!aborted && (++nodes & 63) == 0) {
+        timeval now;
+        gettimeofday(&now, NULL);
+        aborted = now.tv_sec > deadline.tv_sec ||
+            (now.tv_sec == deadline.tv_sec && now.tv_usec >= deadline.tv_usec);
+    }
+    return aborted;
+}
+
+// boxes the player to move can take right away
+int NegamaxSearch::evaluate() const
+{
+    int takeable = 0;
+    board.for_each_node([&] (Node node)
+            { if (this->board.degree(node) == 3) ++takeable; });
+    return takeable;
+}
+
+// fills moves with the macro moves if boxes can be taken, otherwise with the
+// valid edges: the transposition table's move, then moves that don't give a
+// box away, then the rest
+int NegamaxSearch::order_moves(short *moves, int tt_move) const
+{
+    static const MoveKind order[] = {MOVE_SAFE, MOVE_SACRIFICE};
+
+    if (board.num_moves(MOVE_CAPTURE) > 0) {
+        moves[0] = TAKE_ALL;
+        moves[1] = DOUBLE_DEAL;
+        return 2;
+    }
+
+    int nmoves = 0;
+    if (tt_move >= 0)
+        moves[nmoves++] = tt_move;
+
+    for (int k = 0; k < 2; ++k) {
+        board.for_each_move(order[k], [&] (Edge edge)
+                {
+                    int i = this->board.edge_index(edge);
+                    if (i != tt_move)
+                        moves[nmoves++] = i;
+                });
+    }
+
+    return nmoves;
+}
+
+// the value of a move for the player to move, INT_MIN if it is a double deal
+// that can't be played here
+int NegamaxSearch::try_move(int move, int depth, int alpha, int beta)
+{
+    short *played = &played_stack[depth * edges.size()];
+    int oldscore = board.get_score(0);
+    int nplayed = 1;
+    bool again;
+
+    if (move >= 0) {
+        played[0] = move;
+        again = board.move(0, edges[move]);
+    } else {
+        nplayed = play_captures(board, move == DOUBLE_DEAL, played);
+        if (nplayed < 0)
+            return INT_MIN;
+        again = move == TAKE_ALL;
+    }
+
+    int took = board.get_score(0) - oldscore;
+    int value;
+    if (again)
+        value = took + negamax(depth - 1, alpha - took, beta - took);
+    else
+        value = took - negamax(depth - 1, took - beta, took - alpha);
+
+    undo_captures(board, played, nplayed);
+    return value;
+}
+
+// the edge to play now to make a move
+Edge NegamaxSearch::first_edge(int move)
+{
+    if (move >= 0)
+        return edges[move];
+
+    short *played = &played_stack[0];
+    int nplayed = play_captures(board, move == DOUBLE_DEAL, played);
+    assert(nplayed > 0);
+    undo_captures(board, played, nplayed);
+    return edges[played[0]];
+}
+
+int NegamaxSearch::negamax(int depth, int alpha, int beta)
+{
+    if (board.is_game_over())
+        return 0;
+    if (out_of_time())
+        return 0;
+
+    // once every move opens a chain or a loop the value is known exactly
+    if (board.num_moves(MOVE_SAFE) == 0 && board.num_moves(MOVE_CAPTURE) == 0) {
+        StringsAndCoins coins(board);
+        if (coins.is_simple())
+            return coins.value();
+    }
+
+    if (depth == 0)
+        return evaluate();
+
+    uint64_t key = board.get_hash();
+    TTEntry entry;
+    int tt_move = -1;
+    if (process_tt().probe(key, entry)) {
+        tt_move = entry.move;
+        if (entry.depth >= depth) {
+            if (entry.flag == TT_EXACT)
+                return entry.value;
+            if (entry.flag == TT_LOWER && entry.value >= beta)
+                return entry.value;
+            if (entry.flag == TT_UPPER && entry.value <= alpha)
+                return entry.value;
+        }
+    }
+
+    // the remaining depth drops by one each ply, so each gets its own slice
+    short *moves = &move_stack[depth * edges.size()];
+    int nmoves = order_moves(moves, tt_move);
+
+    int original_alpha = alpha;
+    int best = INT_MIN, best_move = -1;
+    for (int i = 0; i < nmoves; ++i) {
+        int value = try_move(moves[i], depth, alpha, beta);
+        if (aborted)
+            return 0;
+        if (value == INT_MIN)
+            continue;
+
+        if (value > best) {
+            best = value;
+            best_move = moves[i];
+        }
+        alpha = std::max(alpha, value);
+        if (alpha >= beta)
+            break;
+    }
+
+    entry.value = best;
+    entry.depth = depth;
+    entry.move = best_move;
+    entry.flag = best <= original_alpha ? TT_UPPER :
+        best >= beta ? TT_LOWER : TT_EXACT;
+    process_tt().store(key, entry);
+
+    return best;
+}
+
+// deepens one ply at a time until the game is searched to the end or the
+// time runs out, playing the best move of the deepest finished search
+Edge NegamaxSearch::search()
+{
+    std::vector<short> moves(edges.size());
+    int nmoves = order_moves(&moves[0], -1);
+    played_stack.resize(edges.size());
+    Edge best_move = first_edge(moves[0]);
+
+    for (int depth = 1; depth <= board.num_free_edges(); ++depth) {
+        move_stack.resize(depth * edges.size());
+        played_stack.resize((depth + 1) * edges.size());
+        int alpha = -board.get_width() * board.get_height() - 1;
+        int beta = -alpha;
+        int best = INT_MIN, best_index = 0;
+
+        for (int i = 0; i < nmoves; ++i) {
+            int value = try_move(moves[i], depth, alpha, beta);
+            if (aborted)
+                return best_move;
+
+            if (value > best) {
+                best = value;
+                best_index = i;
+            }
+            alpha = std::max(alpha, value);
+        }
+
+        // search the best move first next time
+        std::rotate(moves.begin(), moves.begin() + best_index, moves.begin() + best_index + 1);
+        best_move = first_edge(moves[0]);
+    }
+
+    return best_move;
+}
+
+// searches for DOTS_SEARCH_MS milliseconds (800 by default) to stay inside the
+// driver's one second limit
+Edge Board::decide_move_negamax()
+{
+    const char *budget = getenv("DOTS_SEARCH_MS");
+    NegamaxSearch search(*this, budget ? atoi(budget) : 800);
+    return search.search();
+}
@@ -0,0 +1,423 @@
+#include "Nimstring.h"
+#include "MacroMoves.h"
+#include "StringsAndCoins.h"
+
+#include <algorithm>
+#include <map>
+#include <set>
+#include <cstdio>
+#include <cstdlib>
+
+CoinGraph::CoinGraph(int ncoins, const std::vector<std::pair<int, int> > &strings) :
+    ncoins(ncoins), strings(strings)
+{
+}
+
+CoinGraph::CoinGraph(const Board &board) :
+    ncoins(0)
+{
+    int width = board.get_width();
+    std::vector<int> coin(width * board.get_height(), -1);
+    board.for_each_node([&] (Node node)
+            {
+                if (board.degree(node) < 4)
+                    coin[node.y * width + node.x] = this->ncoins++;
+            });
+
+    board.for_each_move([&] (Edge edge)
+            {
+                int ends[2] = {-1, -1}, nends = 0;
+                board.for_each_adjacent_node(edge, [&] (Node node)
+                    { ends[nends++] = coin[node.y * width + node.x]; });
+                this->strings.push_back(std::make_pair(ends[0],
+                            nends == 2 ? ends[1] : this->ncoins));
+            });
+}
+
+// takes coins with one string until none are left, returns false instead if
+// one of them is the end of a loony chain: two or more coins ending at the
+// ground or at a coin with three or more strings, or four or more coins with
+// both ends takeable (an opened loop). Either way the opponent could take all
+// but the last two (or four) and leave the rest.
+bool CoinGraph::take_coins()
+{
+    while (true) {
+        std::vector<std::vector<int> > at(ncoins + 1); // strings at each vertex
+        for (size_t i = 0; i < strings.size(); ++i) {
+            at[strings[i].first].push_back(i);
+            at[strings[i].second].push_back(i);
+        }
+        auto other_end = [&] (int string, int v)
+        { return strings[string].first == v ? strings[string].second : strings[string].first; };
+
+        int take = -1;
+        for (int c = 0; c < ncoins && take == -1; ++c) {
+            if (at[c].size() != 1)
+                continue;
+
+            // walk the chain c starts
+            int string = at[c][0], v = other_end(string, c), length = 1;
+            while (v != ncoins && at[v].size() == 2) {
+                ++length;
+                string = at[v][0] == string ? at[v][1] : at[v][0];
+                v = other_end(string, v);
+            }
+
+            if (v != ncoins && at[v].size() == 1) {
+                if (length + 1 >= 4)
+                    return false;
+            } else if (length >= 2) {
+                return false;
+            }
+            take = at[c][0];
+        }
+
+        if (take == -1) {
+            // drop the taken coins
+            std::vector<int> label(ncoins + 1, -1);
+            int n = 0;
+            for (int c = 0; c < ncoins; ++c) {
+                if (!at[c].empty())
+                    label[c] = n++;
+            }
+            label[ncoins] = n;
+            for (size_t i = 0; i < strings.size(); ++i)
+                strings[i] = std::make_pair(label[strings[i].first], label[strings[i].second]);
+            ncoins = n;
+            return true;
+        }
+
+        strings.erase(strings.begin() + take);
+    }
+}
+
+// the connected parts, joined by coins but not by the ground
+std::vector<CoinGraph> CoinGraph::parts() const
+{
+    std::vector<int> root(ncoins);
+    for (int c = 0; c < ncoins; ++c)
+        root[c] = c;
+    auto find = [&] (int c)
+    {
+        while (root[c] != c)
+            c = root[c] = root[root[c]];
+        return c;
+    };
+
+    for (size_t i = 0; i < strings.size(); ++i) {
+        int a = strings[i].first, b = strings[i].second;
+        if (a != ncoins && b != ncoins)
+            root[find(a)] = find(b);
+    }
+
+    std::vector<int> part(ncoins, -1), label(ncoins);
+    std::vector<CoinGraph> ret;
+    for (int c = 0; c < ncoins; ++c) {
+        int r = find(c);
+        if (part[r] == -1) {
+            part[r] = ret.size();
+            ret.push_back(CoinGraph());
+        }
+        label[c] = ret[part[r]].ncoins++;
+    }
+
+    // every coin left has a string, so every part has at least one
+    for (size_t i = 0; i < strings.size(); ++i) {
+        int a = strings[i].first, b = strings[i].second;
+        int p = part[find(a != ncoins ? a : b)];
+        ret[p].strings.push_back(std::make_pair(a, b));
+    }
+    for (size_t p = 0; p < ret.size(); ++p) {
+        for (size_t i = 0; i < ret[p].strings.size(); ++i) {
+            std::pair<int, int> &s = ret[p].strings[i];
+            s.first = s.first == ncoins ? ret[p].ncoins : label[s.first];
+            s.second = s.second == ncoins ? ret[p].ncoins : label[s.second];
+        }
+    }
+
+    return ret;
+}
+
+// Refines colors until coins of the same color have the same number of
+// strings to coins of each color and to the ground, then ranks the colors
+// by those counts, so the colors don't depend on how the coins are numbered.
+static void refine(int n, const std::vector<int> &mult, std::vector<int> &color)
+{
+    int ncolors = -1;
+    while (true) {
+        std::vector<std::pair<std::vector<int>, int> > sigs(n);
+        for (int v = 0; v < n; ++v) {
+            std::vector<int> &sig = sigs[v].first;
+            sig.push_back(color[v]);
+            sig.push_back(mult[v * (n + 1) + n]);
+            std::vector<int> neighbors;
+            for (int u = 0; u < n; ++u) {
+                for (int k = 0; k < mult[v * (n + 1) + u]; ++k)
+                    neighbors.push_back(color[u]);
+            }
+            std::sort(neighbors.begin(), neighbors.end());
+            sig.insert(sig.end(), neighbors.begin(), neighbors.end());
+            sigs[v].second = v;
+        }
+        std::sort(sigs.begin(), sigs.end());
+
+        int rank = 0;
+        for (int i = 0; i < n; ++i) {
+            if (i > 0 && sigs[i].first != sigs[i - 1].first)
+                ++rank;
+            color[sigs[i].second] = rank;
+        }
+        if (rank == ncolors)
+            return;
+        ncolors = rank;
+    }
+}
+
+// individualizes each coin of the first color class with more than one coin
+// in turn, keeping the smallest code of the fully refined colorings
+static void canonical_search(int n, const std::vector<int> &mult,
+        const std::vector<std::pair<int, int> > &strings, std::vector<int> color,
+        std::vector<int> &best)
+{
+    refine(n, mult, color);
+
+    std::vector<int> count(n, 0);
+    for (int v = 0; v < n; ++v)
+        ++count[color[v]];
+    int cell = std::find_if(count.begin(), count.end(),
+            [] (int c) { return c > 1; }) - count.begin();
+
+    if (cell == n) {
+        std::vector<int> code(1, n);
+        std::vector<std::pair<int, int> > mapped;
+        for (size_t i = 0; i < strings.size(); ++i) {
+            int a = strings[i].first == n ? n : color[strings[i].first];
+            int b = strings[i].second == n ? n : color[strings[i].second];
+            mapped.push_back(std::make_pair(std::min(a, b), std::max(a, b)));
+        }
+        std::sort(mapped.begin(), mapped.end());
+        for (size_t i = 0; i < mapped.size(); ++i) {
+            code.push_back(mapped[i].first);
+            code.push_back(mapped[i].second);
+        }
+        if (best.empty() || code < best)
+            best = code;
+        return;
+    }
+
+    for (int v = 0; v < n; ++v) {
+        if (color[v] != cell)
+            continue;
+        std::vector<int> split(n);
+        for (int u = 0; u < n; ++u)
+            split[u] = 2 * color[u] + (u != v);
+        canonical_search(n, mult, strings, split, best);
+    }
+}
+
+// the same for every numbering of the coins
+std::vector<int> CoinGraph::canonical_code() const
+{
+    int n = ncoins;
+    std::vector<int> mult((n + 1) * (n + 1), 0);
+    for (size_t i = 0; i < strings.size(); ++i) {
+        int a = strings[i].first, b = strings[i].second;
+        ++mult[a * (n + 1) + b];
+        if (a != b)
+            ++mult[b * (n + 1) + a];
+    }
+
+    std::vector<int> best;
+    canonical_search(n, mult, strings, std::vector<int>(n, 0), best);
+    return best;
+}
+
+typedef std::map<std::vector<int>, int> NimCache;
+
+// Grundy values of parts by canonical_code(). Not locked, the deciders and
+// searches that use it are single threaded.
+static NimCache &nim_cache()
+{
+    static NimCache cache;
+    return cache;
+}
+
+// DOTS_NIM_CACHE's file, NULL without one. Each line is a value, the length
+// of its code and the code. Lines are appended with a single write, so both
+// players' processes can share the file; a line cut short by a killed
+// process ends the loading and the values after it are found again.
+static FILE *nim_cache_file = NULL;
+
+static void load_nim_cache()
+{
+    const char *path = getenv("DOTS_NIM_CACHE");
+    if (!path)
+        return;
+
+    FILE *in = fopen(path, "r");
+    if (in) {
+        int value, n;
+        while (fscanf(in, "%d %d", &value, &n) == 2 && n > 0) {
+            std::vector<int> code(n);
+            bool complete = true;
+            for (int i = 0; i < n && complete; ++i)
+                complete = fscanf(in, "%d", &code[i]) == 1;
+            if (!complete)
+                break;
+            nim_cache()[code] = value;
+        }
+        fclose(in);
+    }
+
+    nim_cache_file = fopen(path, "a");
+    if (!nim_cache_file) {
+        perror(path);
+        exit(1);
+    }
+}
+
+static void save_nim_value(const std::vector<int> &code, int value)
+{
+    nim_cache()[code] = value;
+    if (!nim_cache_file)
+        return;
+
+    fprintf(nim_cache_file, "%d %d", value, (int)code.size());
+    for (size_t i = 0; i < code.size(); ++i)
+        fprintf(nim_cache_file, " %d", code[i]);
+    fprintf(nim_cache_file, "\n");
+    fflush(nim_cache_file);
+}
+
+// the Grundy value of a connected graph without coins to take: the least
+// value no move leads to, leaving out the loony moves
+int CoinGraph::part_value() const
+{
+    std::vector<int> code = canonical_code();
+    NimCache::iterator it = nim_cache().find(code);
+    if (it != nim_cache().end())
+        return it->second;
+
+    std::set<int> options;
+    for (size_t i = 0; i < strings.size(); ++i) {
+        CoinGraph next(*this);
+        next.strings.erase(next.strings.begin() + i);
+        if (!next.take_coins())
+            continue;
+
+        std::vector<CoinGraph> next_parts = next.parts();
+        int value = 0;
+        for (size_t p = 0; p < next_parts.size(); ++p)
+            value ^= next_parts[p].part_value();
+        options.insert(value);
+    }
+
+    int value = 0;
+    while (options.count(value))
+        ++value;
+
+    save_nim_value(code, value);
+    return value;
+}
+
+// loads the cache's file and fills in the chains between two pieces of ground
+// and the loops that make up most endgames
+static void precompute_shapes()
+{
+    static bool done = false;
+    if (done)
+        return;
+    done = true;
+
+    load_nim_cache();
+
+    for (int n = 1; n <= 12; ++n) {
+        std::vector<std::pair<int, int> > chain, loop;
+        chain.push_back(std::make_pair(0, n));
+        for (int c = 0; c < n; ++c) {
+            chain.push_back(std::make_pair(c, c + 1 < n ? c + 1 : n));
+            loop.push_back(std::make_pair(c, (c + 1) % n));
+        }
+        CoinGraph(n, chain).value();
+        if (n >= 4)
+            CoinGraph(n, loop).value();
+    }
+}
+
+int CoinGraph::value(int max_strings) const
+{
+    precompute_shapes();
+
+    CoinGraph graph(*this);
+    if (!graph.take_coins())
+        return NIM_LOONY;
+
+    std::vector<CoinGraph> graph_parts = graph.parts();
+    for (size_t p = 0; p < graph_parts.size(); ++p) {
+        if ((int)graph_parts[p].strings.size() > max_strings)
+            return NIM_UNKNOWN;
+    }
+
+    int value = 0;
+    for (size_t p = 0; p < graph_parts.size(); ++p)
+        value ^= graph_parts[p].part_value();
+    return value;
+}
+
+bool estimate_endgame(const Board &board, int &value, int max_strings)
+{
+    StringsAndCoins coins(board);
+    if (coins.is_simple()) {
+        value = coins.value();
+        return true;
+    }
+
+    int nim = CoinGraph(board).value(max_strings);
+    if (nim < 0)
+        return false;
+    value = nim != 0 ? coins.controlled_value() : -coins.controlled_value();
+    return true;
+}
+
+// Offered a chain or a loop, takes all of it unless handing the last two (or
+// four) boxes over is worth more: the opponent then has to move in the rest,
+// as the player would after taking everything. Otherwise wins the nimstring
+// game if the parts of the board are small enough to value, otherwise plays
+// like nocheap.
+Edge Board::decide_move_nimstring()
+{
+    if (num_moves(MOVE_CAPTURE) > 0) {
+        std::vector<short> played(num_edges());
+        Board rest(*this), dealt(*this);
+        play_captures(rest, false, &played[0]);
+        int took_all = rest.get_score(0) - get_score(0);
+
+        int value;
+        if (play_captures(dealt, true, &played[0]) > 0 &&
+                estimate_endgame(rest, value)) {
+            int took = dealt.get_score(0) - get_score(0);
+            if (took - (took_all - took) - value > took_all + value)
+                return edge_at(played[0]);
+        }
+        return nth_move(MOVE_CAPTURE, 0);
+    }
+
+    Edge winning(HORIZ, -1, -1);
+    bool unknown = false;
+    for_each_move([&] (Edge edge)
+            {
+                if (unknown || this->is_move_valid(winning))
+                    return;
+                Board next(*this);
+                next.move(0, edge);
+                int value = CoinGraph(next).value();
+                if (value == NIM_UNKNOWN)
+                    unknown = true;
+                else if (value == 0)
+                    winning = edge;
+            });
+
+    if (is_move_valid(winning))
+        return winning;
+    return decide_move_nocheap();
+}
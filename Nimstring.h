@@ -0,0 +1,59 @@
+#ifndef NIMSTRING_H
+#define NIMSTRING_H
+
+#include "Board.h"
+
+#include <vector>
+#include <utility>
+
+// Nimstring is dots and boxes played on the strings-and-coins graph where the
+// player who can't move loses, so boxes only matter for who moves next. The
+// player who wins the nimstring game usually gets control of the long chains
+// in dots and boxes. Its value is the nim sum of the Grundy values of the
+// graph's connected parts, which CoinGraph computes and caches by the part's
+// shape so a part is only ever searched once. With DOTS_NIM_CACHE naming a
+// file the cache is kept there from one process to the next.
+//
+// Following Berlekamp, coins that can be taken are taken before a position is
+// valued, and a move that offers a chain of two or more coins from its end
+// (loony, the opponent may take all or decline the last two) loses and is
+// left out.
+
+const int NIM_UNKNOWN = -1; // a part has more than CoinGraph::MAX_STRINGS strings
+const int NIM_LOONY = -2; // the player to move was offered a loony move
+
+class CoinGraph
+{
+    public:
+        static const int MAX_STRINGS = 18;
+
+        // ground is vertex ncoins, strings join two vertices
+        CoinGraph(int ncoins, const std::vector<std::pair<int, int> > &strings);
+        CoinGraph(const Board &board);
+
+        // after the player to move takes every coin they can; NIM_LOONY if
+        // they are offered a loony move instead. Parts with more than
+        // max_strings strings are NIM_UNKNOWN
+        int value(int max_strings = MAX_STRINGS) const;
+
+    private:
+        CoinGraph() : ncoins(0) {}
+
+        bool take_coins();
+        std::vector<CoinGraph> parts() const;
+        std::vector<int> canonical_code() const;
+        int part_value() const;
+
+        int ncoins;
+        std::vector<std::pair<int, int> > strings;
+};
+
+// A guess at the score difference the player to move gets from the rest of a
+// position with no boxes to take: exact once it is simple, otherwise the
+// controlled value of the long chains and loops for whoever wins the
+// nimstring game, who can make the other player open the first of them.
+// False if a part has more than max_strings strings.
+bool estimate_endgame(const Board &board, int &value,
+        int max_strings = CoinGraph::MAX_STRINGS);
+
+#endif
@@ -0,0 +1,76 @@
+#ifndef PACKED_TABLE_H
+#define PACKED_TABLE_H
+
+#include <vector>
+#include <stdint.h>
+
+// Score differences between -nboxes and nboxes, stored offset by nboxes in
+// the fewest bits that hold them. Lanes never straddle a word. Entries start
+// out as 0 and are each set once, so set() can be called from several threads
+// at the same time. The words are either owned by the table or, read only,
+// somewhere else such as a mapped tablebase file.
+class PackedTable
+{
+    public:
+        PackedTable(int nboxes, unsigned long size);
+        PackedTable(int nboxes, unsigned long size, const uint64_t *words);
+
+        int get(unsigned long idx) const;
+        void set(unsigned long idx, int score);
+
+        int lane_bits() const { return bits; }
+        unsigned long size() const { return nentries; }
+        const uint64_t *data() const { return words; }
+        size_t num_words() const { return (nentries + lanes - 1) / lanes; }
+        size_t size_bytes() const { return num_words() * sizeof(uint64_t); }
+
+        static int lane_bits(int nboxes);
+
+    private:
+        PackedTable(const PackedTable &);
+        PackedTable &operator=(const PackedTable &);
+
+        int nboxes, bits, lanes;
+        uint64_t mask;
+        unsigned long nentries;
+        std::vector<uint64_t> storage;
+        uint64_t *words;
+};
+
+inline int PackedTable::lane_bits(int nboxes)
+{
+    int bits = 4;
+    while ((1 << bits) < 2 * nboxes + 1)
+        ++bits;
+    return bits;
+}
+
+inline PackedTable::PackedTable(int nboxes, unsigned long size) :
+    nboxes(nboxes), bits(lane_bits(nboxes)), lanes(64 / bits),
+    mask((((uint64_t)1) << bits) - 1), nentries(size),
+    storage(num_words(), 0), words(&storage[0])
+{
+}
+
+inline PackedTable::PackedTable(int nboxes, unsigned long size, const uint64_t *words) :
+    nboxes(nboxes), bits(lane_bits(nboxes)), lanes(64 / bits),
+    mask((((uint64_t)1) << bits) - 1), nentries(size),
+    words(const_cast<uint64_t *>(words))
+{
+}
+
+// the load is atomic because other threads may be setting other lanes of
+// the same word
+inline int PackedTable::get(unsigned long idx) const
+{
+    uint64_t word = __atomic_load_n(&words[idx / lanes], __ATOMIC_RELAXED);
+    return (int)((word >> (idx % lanes * bits)) & mask) - nboxes;
+}
+
+inline void PackedTable::set(unsigned long idx, int score)
+{
+    uint64_t lane = ((uint64_t)(score + nboxes)) << (idx % lanes * bits);
+    __sync_fetch_and_or(&words[idx / lanes], lane);
+}
+
+#endif
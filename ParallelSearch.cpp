@@ -0,0 +1,538 @@
+#include "ParallelSearch.h"
+#include "MacroMoves.h"
+#include "SmallArray.h"
+#include "StringsAndCoins.h"
+#include "TranspositionTable.h"
+
+#include <algorithm>
+#include <deque>
+#include <climits>
+#include <cstdlib>
+
+#include <sched.h>
+#include <unistd.h>
+
+// nodes with less depth left than this are searched by one thread, splitting
+// them costs more than it saves
+static const int SPLIT_DEPTH = 4;
+
+struct SplitPoint
+{
+    SplitPoint(const Board &board, SplitPoint *parent, const short *moves, int nmoves,
+            int depth, int alpha, int beta, int best, int best_move);
+    ~SplitPoint() { pthread_mutex_destroy(&lock); }
+
+    Board board; // the position at the node, copied by each thread
+    SplitPoint *parent; // the nearest split point above, NULL at the top
+    const short *moves;
+    int nmoves, depth, beta;
+
+    volatile int next; // the next move to hand out
+    volatile int alpha, best, best_move; // updated under lock
+    volatile int nworkers; // threads other than the owner working on it
+    volatile bool cutoff;
+    pthread_mutex_t lock;
+};
+
+SplitPoint::SplitPoint(const Board &board, SplitPoint *parent, const short *moves, int nmoves,
+        int depth, int alpha, int beta, int best, int best_move) :
+    board(board), parent(parent), moves(moves), nmoves(nmoves), depth(depth), beta(beta),
+    next(0), alpha(alpha), best(best), best_move(best_move), nworkers(0), cutoff(false)
+{
+    pthread_mutex_init(&lock, NULL);
+}
+
+class SearchWorker
+{
+    public:
+        SearchWorker(ParallelSearch &search, int id);
+        ~SearchWorker() { pthread_mutex_destroy(&deque_lock); }
+
+        // as negamax, storing the best move in best_move if it isn't NULL
+        int negamax(Board &board, int depth, int alpha, int beta,
+                SplitPoint *parent, int *best_move = NULL);
+        // runs stolen work until the search is done
+        void help();
+
+        unsigned long nodes;
+
+    private:
+        int child_value(Board &board, int move, int depth, int alpha, int beta,
+                SplitPoint *parent);
+        int evaluate(const Board &board) const;
+        int order_moves(const Board &board, short *moves, int tt_move) const;
+        void split(const Board &board, int depth, int &alpha, int beta, int &best,
+                int &best_move, const short *moves, int nmoves, SplitPoint *parent);
+        void work(SplitPoint &sp);
+        bool steal();
+        bool aborted(const SplitPoint *sp) const;
+
+        ParallelSearch &search;
+        int id;
+        std::deque<SplitPoint *> split_points; // oldest first
+        pthread_mutex_t deque_lock;
+};
+
+SearchWorker::SearchWorker(ParallelSearch &search, int id) :
+    nodes(0), search(search), id(id)
+{
+    pthread_mutex_init(&deque_lock, NULL);
+}
+
+// the search is out of time or a split point above has failed high
+bool SearchWorker::aborted(const SplitPoint *sp) const
+{
+    if (search.stop)
+        return true;
+    for (; sp; sp = sp->parent) {
+        if (sp->cutoff)
+            return true;
+    }
+    return false;
+}
+
+// boxes the player to move can take right away
+int SearchWorker::evaluate(const Board &board) const
+{
+    int takeable = 0;
+    board.for_each_node([&] (Node node)
+            { if (board.degree(node) == 3) ++takeable; });
+    return takeable;
+}
+
+// fills moves with the macro moves if boxes can be taken, otherwise with the
+// valid edges: the transposition table's move, then moves that don't give a
+// box away, then the rest
+int SearchWorker::order_moves(const Board &board, short *moves, int tt_move) const
+{
+    static const MoveKind order[] = {MOVE_SAFE, MOVE_SACRIFICE};
+
+    if (board.num_moves(MOVE_CAPTURE) > 0) {
+        moves[0] = TAKE_ALL;
+        moves[1] = DOUBLE_DEAL;
+        return 2;
+    }
+
+    // a border edge whose box has an earlier one free is the same move
+    auto repeated = [&] (int i)
+    {
+        int before = search.ground_before[i];
+        return before >= 0 && board.is_move_valid(search.edges[before]);
+    };
+
+    int nmoves = 0;
+    if (tt_move >= 0 && board.is_move_valid(search.edges[tt_move]) && !repeated(tt_move))
+        moves[nmoves++] = tt_move;
+
+    for (int k = 0; k < 2; ++k) {
+        board.for_each_move(order[k], [&] (Edge edge)
+                {
+                    int i = board.edge_index(edge);
+                    if (i != tt_move && !repeated(i))
+                        moves[nmoves++] = i;
+                });
+    }
+
+    return nmoves;
+}
+
+// the value of a move for the player to move, INT_MIN if it is a double deal
+// that can't be played here
+int SearchWorker::child_value(Board &board, int move, int depth, int alpha, int beta,
+        SplitPoint *parent)
+{
+    SmallArray<short, 128> played(move >= 0 ? 1 : board.num_edges());
+    int oldscore = board.get_score(0);
+    int nplayed = 1;
+    bool again;
+
+    if (move >= 0) {
+        played[0] = move;
+        again = board.move(0, search.edges[move]);
+    } else {
+        nplayed = play_captures(board, move == DOUBLE_DEAL, &played[0]);
+        if (nplayed < 0)
+            return INT_MIN;
+        again = move == TAKE_ALL;
+    }
+
+    int took = board.get_score(0) - oldscore;
+    int value;
+    if (again)
+        value = took + negamax(board, depth - 1, alpha - took, beta - took, parent);
+    else
+        value = took - negamax(board, depth - 1, took - beta, took - alpha, parent);
+
+    undo_captures(board, &played[0], nplayed);
+    return value;
+}
+
+int SearchWorker::negamax(Board &board, int depth, int alpha, int beta,
+        SplitPoint *parent, int *best_move_out)
+{
+    if (board.is_game_over())
+        return 0;
+
+    // once every move opens a chain or a loop the value is known exactly,
+    // but the top of the search still has to find the move
+    if (!best_move_out && board.num_moves(MOVE_SAFE) == 0 && board.num_moves(MOVE_CAPTURE) == 0) {
+        StringsAndCoins coins(board);
+        if (coins.is_simple())
+            return coins.value();
+    }
+
+    // a search to the end of the game is as good as a deeper one, so they
+    // all share their table entries
+    depth = std::min(depth, board.num_free_edges());
+    if (depth == 0)
+        return evaluate(board);
+
+    // nor can the rest of the game be worth more than the boxes left
+    int remaining = search.total_boxes - board.get_score(0) - board.get_score(1);
+    if (!best_move_out && remaining <= alpha)
+        return remaining;
+    if (!best_move_out && -remaining >= beta)
+        return -remaining;
+
+    if ((++nodes & 1023) == 0 && search.out_of_time())
+        search.stop = true;
+    if (aborted(parent))
+        return 0;
+
+    // symmetric positions share an entry, with its move stored for the
+    // position the key is the hash of
+    int transform;
+    uint64_t key = board.get_symmetric_hash(&transform);
+    const BoardSymmetry &symmetry = search.symmetry;
+    TTEntry entry;
+    int tt_move = -1;
+    if (process_tt().probe(key, entry)) {
+        if (entry.move >= 0)
+            tt_move = symmetry.transform_index(symmetry.inverse(transform), entry.move);
+        if (!best_move_out && entry.depth >= depth) {
+            if (entry.flag == TT_EXACT)
+                return entry.value;
+            if (entry.flag == TT_LOWER && entry.value >= beta)
+                return entry.value;
+            if (entry.flag == TT_UPPER && entry.value <= alpha)
+                return entry.value;
+        }
+    }
+
+    SmallArray<short, 128> moves(board.num_edges());
+    int nmoves = order_moves(board, &moves[0], tt_move);
+    int original_alpha = alpha;
+
+    // the eldest brother goes first and alone
+    int best = child_value(board, moves[0], depth, alpha, beta, parent);
+    int best_move = moves[0];
+    if (aborted(parent))
+        return 0;
+    alpha = std::max(alpha, best);
+
+    if (alpha < beta && nmoves > 1) {
+        if (depth >= SPLIT_DEPTH && search.idle > 0) {
+            split(board, depth, alpha, beta, best, best_move, &moves[1], nmoves - 1, parent);
+        } else {
+            for (int i = 1; i < nmoves; ++i) {
+                int value = child_value(board, moves[i], depth, alpha, beta, parent);
+                if (aborted(parent))
+                    return 0;
+                if (value == INT_MIN)
+                    continue;
+
+                if (value > best) {
+                    best = value;
+                    best_move = moves[i];
+                }
+                alpha = std::max(alpha, value);
+                if (alpha >= beta)
+                    break;
+            }
+        }
+    }
+
+    if (aborted(parent))
+        return 0;
+
+    entry.value = best;
+    entry.depth = depth;
+    entry.move = best_move >= 0 ? symmetry.transform_index(transform, best_move) : best_move;
+    entry.flag = best <= original_alpha ? TT_UPPER :
+        best >= beta ? TT_LOWER : TT_EXACT;
+    process_tt().store(key, entry);
+
+    if (best_move_out)
+        *best_move_out = best_move;
+    return best;
+}
+
+// searches the rest of a node's moves with any threads that steal them,
+// leaving alpha, best and best_move as if they had been searched in turn
+void SearchWorker::split(const Board &board, int depth, int &alpha, int beta, int &best,
+        int &best_move, const short *moves, int nmoves, SplitPoint *parent)
+{
+    SplitPoint sp(board, parent, moves, nmoves, depth, alpha, beta, best, best_move);
+
+    pthread_mutex_lock(&deque_lock);
+    split_points.push_back(&sp);
+    pthread_mutex_unlock(&deque_lock);
+
+    work(sp);
+
+    // nobody joins once it is off the deque, so only the ones already
+    // working need waiting for
+    pthread_mutex_lock(&deque_lock);
+    split_points.erase(std::find(split_points.begin(), split_points.end(), &sp));
+    pthread_mutex_unlock(&deque_lock);
+
+    __sync_add_and_fetch(&search.idle, 1);
+    while (sp.nworkers > 0) {
+        if (!steal())
+            sched_yield();
+    }
+    __sync_sub_and_fetch(&search.idle, 1);
+
+    alpha = sp.alpha;
+    best = sp.best;
+    best_move = sp.best_move;
+}
+
+// takes moves from sp until there are none left
+void SearchWorker::work(SplitPoint &sp)
+{
+    Board board(sp.board);
+
+    for (;;) {
+        int i = __sync_fetch_and_add(&sp.next, 1);
+        if (i >= sp.nmoves || aborted(&sp))
+            break;
+
+        int value = child_value(board, sp.moves[i], sp.depth, sp.alpha, sp.beta, &sp);
+        if (aborted(&sp))
+            break;
+        if (value == INT_MIN)
+            continue;
+
+        pthread_mutex_lock(&sp.lock);
+        if (value > sp.best) {
+            sp.best = value;
+            sp.best_move = sp.moves[i];
+        }
+        if (value > sp.alpha)
+            sp.alpha = value;
+        if (sp.alpha >= sp.beta)
+            sp.cutoff = true;
+        pthread_mutex_unlock(&sp.lock);
+    }
+}
+
+// works on the oldest split point with moves left on another thread's deque,
+// false if there isn't one
+bool SearchWorker::steal()
+{
+    int nworkers = search.workers.size();
+    for (int k = 1; k < nworkers; ++k) {
+        SearchWorker *victim = search.workers[(id + k) % nworkers];
+        SplitPoint *sp = NULL;
+
+        pthread_mutex_lock(&victim->deque_lock);
+        for (size_t i = 0; i < victim->split_points.size(); ++i) {
+            SplitPoint *candidate = victim->split_points[i];
+            if (candidate->next < candidate->nmoves && !candidate->cutoff) {
+                sp = candidate;
+                __sync_add_and_fetch(&sp->nworkers, 1);
+                break;
+            }
+        }
+        pthread_mutex_unlock(&victim->deque_lock);
+
+        if (!sp)
+            continue;
+
+        __sync_sub_and_fetch(&search.idle, 1);
+        work(*sp);
+        __sync_add_and_fetch(&search.idle, 1);
+        __sync_sub_and_fetch(&sp->nworkers, 1);
+        return true;
+    }
+    return false;
+}
+
+void SearchWorker::help()
+{
+    __sync_add_and_fetch(&search.idle, 1);
+    while (!search.done) {
+        if (!steal())
+            sched_yield();
+    }
+    __sync_sub_and_fetch(&search.idle, 1);
+}
+
+static int tt_width = -1, tt_height = -1;
+
+ParallelSearch::ParallelSearch(const Board &board, int nthreads) :
+    symmetry(board), board(board), edges(board.num_edges()),
+    ground_before(board.num_edges(), -1),
+    total_boxes(board.get_score(0) + board.get_score(1)), timed(false), stop(false), done(false), idle(0)
+{
+    this->board.track_symmetric_hash(&symmetry);
+
+    Board empty(board.get_width(), board.get_height());
+    std::for_each(empty.edge_begin(), empty.edge_end(), [&] (Edge edge)
+            {
+                if (empty.is_move_valid(edge))
+                    this->edges[empty.edge_index(edge)] = edge;
+            });
+
+    board.for_each_node([&] (Node node)
+            { if (board.degree(node) < 4) ++this->total_boxes; });
+
+    std::vector<short> last_border(board.get_width() * board.get_height(), -1);
+    for (size_t i = 0; i < edges.size(); ++i) {
+        int nnodes = 0;
+        Node box;
+        empty.for_each_adjacent_node(edges[i], [&] (Node node) { box = node; ++nnodes; });
+        if (nnodes == 1) {
+            short &last = last_border[box.y * board.get_width() + box.x];
+            ground_before[i] = last;
+            last = i;
+        }
+    }
+
+    for (int i = 0; i < nthreads; ++i)
+        workers.push_back(new SearchWorker(*this, i));
+
+    // entries stay useful from one move to the next, but not across sizes
+    if (tt_width != board.get_width() || tt_height != board.get_height()) {
+        process_tt().clear();
+        tt_width = board.get_width();
+        tt_height = board.get_height();
+    } else {
+        process_tt().new_search();
+    }
+}
+
+ParallelSearch::~ParallelSearch()
+{
+    for (size_t i = 0; i < workers.size(); ++i)
+        delete workers[i];
+}
+
+unsigned long ParallelSearch::num_nodes() const
+{
+    unsigned long nodes = 0;
+    for (size_t i = 0; i < workers.size(); ++i)
+        nodes += workers[i]->nodes;
+    return nodes;
+}
+
+bool ParallelSearch::out_of_time() const
+{
+    if (!timed)
+        return false;
+
+    timeval now;
+    gettimeofday(&now, NULL);
+    return now.tv_sec > deadline.tv_sec ||
+        (now.tv_sec == deadline.tv_sec && now.tv_usec >= deadline.tv_usec);
+}
+
+// the edge to play now to make a move
+Edge ParallelSearch::first_edge(Board &board, int move) const
+{
+    if (move >= 0)
+        return edges[move];
+
+    SmallArray<short, 128> played(board.num_edges());
+    int nplayed = play_captures(board, move == DOUBLE_DEAL, &played[0]);
+    undo_captures(board, &played[0], nplayed);
+    return edges[played[0]];
+}
+
+void *ParallelSearch::run_thread(void *arg)
+{
+    ((SearchWorker *)arg)->help();
+    return NULL;
+}
+
+std::pair<Edge, short> ParallelSearch::solve(int budget_ms)
+{
+    if (board.is_game_over())
+        return std::make_pair(Edge(HORIZ, -1, -1), (short)0);
+
+    timed = budget_ms >= 0;
+    if (timed) {
+        gettimeofday(&deadline, NULL);
+        deadline.tv_sec += budget_ms / 1000;
+        deadline.tv_usec += budget_ms % 1000 * 1000;
+        if (deadline.tv_usec >= 1000000) {
+            ++deadline.tv_sec;
+            deadline.tv_usec -= 1000000;
+        }
+    }
+    stop = false;
+    done = false;
+
+    // the calling thread searches from the top, the rest start out idle
+    std::vector<pthread_t> threads(workers.size());
+    for (size_t i = 1; i < workers.size(); ++i)
+        pthread_create(&threads[i], NULL, &ParallelSearch::run_thread, workers[i]);
+
+    std::pair<Edge, short> best(board.nth_move(MOVE_ANY, 0), 0);
+    int nboxes = board.get_width() * board.get_height();
+    Board root(board);
+    // no search goes more than a ply per free edge deep, and the table keeps
+    // depths in a signed char
+    int last = std::min(board.num_free_edges(), 127);
+    if (timed) {
+        for (int depth = 1; depth <= last; ++depth) {
+            int move = -1;
+            int value = workers[0]->negamax(root, depth, -nboxes - 1, nboxes + 1, NULL, &move);
+            if (stop)
+                break;
+            best = std::make_pair(first_edge(root, move), (short)value);
+        }
+    } else {
+        // Without a time limit only searches to the end are needed. Each
+        // one asks whether the value is at least a guess halfway between the
+        // bounds known so far, which cuts off much more than a search for the
+        // exact value would, and the table keeps what they find. The value
+        // has the parity of the boxes left, so only those values are guessed
+        int remaining = total_boxes - board.get_score(0) - board.get_score(1);
+        int low = -remaining, high = remaining;
+        bool found = false;
+        while (low < high) {
+            int guess = low + (high - low + 2) / 4 * 2;
+            int move = -1;
+            int value = workers[0]->negamax(root, last, guess - 1, guess, NULL, &move);
+            if (value >= guess) {
+                low = value + ((value - remaining) & 1);
+                best = std::make_pair(first_edge(root, move), (short)low);
+                found = true;
+            } else {
+                high = value - ((value - remaining) & 1);
+                if (!found)
+                    best = std::make_pair(first_edge(root, move), (short)high);
+            }
+        }
+    }
+
+    done = true;
+    for (size_t i = 1; i < workers.size(); ++i)
+        pthread_join(threads[i], NULL);
+
+    return best;
+}
+
+// searches for DOTS_SEARCH_MS milliseconds (800 by default) on DOTS_THREADS
+// threads (one per core by default)
+Edge Board::decide_move_ybwc()
+{
+    const char *budget = getenv("DOTS_SEARCH_MS");
+    const char *threads = getenv("DOTS_THREADS");
+    int nthreads = threads ? atoi(threads) : sysconf(_SC_NPROCESSORS_ONLN);
+
+    ParallelSearch search(*this, std::max(nthreads, 1));
+    return search.solve(budget ? atoi(budget) : 800).first;
+}
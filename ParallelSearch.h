@@ -0,0 +1,76 @@
+#ifndef PARALLEL_SEARCH_H
+#define PARALLEL_SEARCH_H
+
+#include "Board.h"
+#include "Symmetry.h"
+
+#include <utility>
+#include <vector>
+
+#include <pthread.h>
+#include <sys/time.h>
+
+struct SplitPoint;
+class SearchWorker;
+
+// Alpha-beta search that runs in parallel inside the tree with the Young
+// Brothers Wait concept: a node's first move is always searched alone, and
+// only once it has set a bound may the rest be searched at the same time.
+// Values are score differences for the player to move, as in negamax.
+//
+// A thread that gets to the rest of a node's moves with other threads idle
+// makes the node a split point, pushes it onto its own deque and carries on
+// taking moves from it. Idle threads steal the oldest split point that still
+// has moves from another thread's deque and take moves from it too, each on
+// its own copy of the board. The owner waits for the thieves by stealing
+// work itself. A split point whose moves fail high stops every search below
+// it. Results go through the shared process_tt(), keyed by the symmetric
+// hash so that the positions symmetric to one another share an entry.
+//
+// Where boxes can be taken it only branches on the two macro moves of
+// MacroMoves.h. A box's edges on the border of the board all join it to the
+// ground, so filling any one of them leaves the same strings and coins; they
+// are only played in edge_index order.
+class ParallelSearch
+{
+    public:
+        ParallelSearch(const Board &board, int nthreads);
+        ~ParallelSearch();
+
+        // deepens one ply at a time until every free edge has been played
+        // or budget_ms is up, returning the best move and value of the
+        // deepest finished search. Without a time limit (budget_ms negative)
+        // it only searches to the end and the value is exact.
+        std::pair<Edge, short> solve(int budget_ms);
+
+        unsigned long num_nodes() const;
+
+    private:
+        friend class SearchWorker;
+
+        ParallelSearch(const ParallelSearch &);
+        ParallelSearch &operator=(const ParallelSearch &);
+
+        static void *run_thread(void *arg);
+        bool out_of_time() const;
+        Edge first_edge(Board &board, int move) const;
+
+        BoardSymmetry symmetry; // board's, it tracks the symmetric hash
+        Board board;
+        std::vector<Edge> edges; // by edge_index
+        // the border edge of the same box before each border edge, -1 for
+        // the first and for the other edges
+        std::vector<short> ground_before;
+        // boxes not yet taken plus both scores, the same all through the
+        // search
+        int total_boxes;
+        std::vector<SearchWorker *> workers;
+
+        bool timed;
+        timeval deadline;
+        volatile bool stop; // out of time
+        volatile bool done; // the helpers can exit
+        volatile int idle; // threads looking for work
+};
+
+#endif
@@ -0,0 +1,440 @@
+#include "Playout.h"
+
+#include <algorithm>
+
+// GCC 12 warns about the intrinsics' own deliberately undefined values
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#include <immintrin.h>
+#pragma GCC diagnostic pop
+
+// xoshiro256** run in every lane at once, seeded from the caller's generator
+struct LaneRandom
+{
+    typedef uint64_t Words __attribute__((vector_size(8 * PlayoutEngine::LANES)));
+
+    explicit LaneRandom(Random &random)
+    {
+        for (int k = 0; k < 4; ++k) {
+            for (int l = 0; l < PlayoutEngine::LANES; ++l)
+                s[k][l] = random.next();
+        }
+    }
+
+    // through a reference, as vectors wider than the machine's registers
+    // aren't returned the same way by every compiler setting
+    void next(Words &result)
+    {
+        // the multiplications by 5 and 9 as shifts, which every vector unit has
+        Words x = (s[1] << 2) + s[1];
+        x = (x << 7) | (x >> 57);
+        result = (x << 3) + x;
+        Words t = s[1] << 17;
+
+        s[2] ^= s[0];
+        s[3] ^= s[1];
+        s[1] ^= s[2];
+        s[0] ^= s[3];
+        s[2] ^= t;
+        s[3] = (s[3] << 45) | (s[3] >> 19);
+    }
+
+    Words s[4];
+};
+
+PlayoutEngine::PlayoutEngine(int width, int height) :
+    nboxes(width * height)
+{
+    Board empty(width, height);
+    nedges = empty.num_edges();
+    edge_boxes.assign(2 * nedges, nboxes);
+    box_edges.resize(4 * nboxes);
+
+    for (int i = 0; i < nedges; ++i) {
+        int *box = &edge_boxes[2 * i];
+        empty.for_each_adjacent_node(empty.edge_at(i), [&] (Node node)
+                { *box++ = node.y * width + node.x; });
+    }
+
+    empty.for_each_node([&] (Node node)
+            {
+                int *edge = &this->box_edges[4 * (node.y * width + node.x)];
+                empty.for_each_adjacent_edge(node, [&] (Edge e)
+                    { *edge++ = empty.edge_index(e); });
+            });
+
+    other_masks.resize(2 * nedges);
+    other_edges.resize(6 * nedges);
+    uniform_order.resize(nedges * LANES);
+    lane_order.resize(64 * LANES);
+
+    free_edges.resize(nedges);
+    order.resize(nedges * LANES);
+    slot.resize(nedges * LANES);
+    base_sides.assign(nboxes + 1, 2 * nedges + 2);
+    sides.resize((nboxes + 1) * LANES);
+    ready.resize(nboxes * LANES);
+}
+
+// numbers the board's free edges and finds the other free edges of the
+// boxes on both sides of each
+void PlayoutEngine::setup_uniform(const Board &board)
+{
+    int nfree = board.num_free_edges();
+    std::vector<int> number(nedges, -1);
+    int n = 0;
+    board.for_each_move([&] (Edge edge) { number[board.edge_index(edge)] = n++; });
+
+    // number nfree is the filled edge the three numbers are padded with
+    nwords = (nfree + 1 + 63) / 64;
+    filled.resize(nwords * LANES);
+
+    board.for_each_move([&] (Edge edge)
+            {
+                int i = board.edge_index(edge), j = number[i];
+                for (int side = 0; side < 2; ++side) {
+                    int box = this->edge_boxes[2 * i + side];
+                    uint64_t &mask = this->other_masks[2 * j + side];
+                    int *others = &this->other_edges[6 * j + 3 * side];
+
+                    if (box == this->nboxes) {
+                        mask = ((uint64_t)1) << (j & 63);
+                        std::fill(others, others + 3, j);
+                        continue;
+                    }
+
+                    mask = 0;
+                    std::fill(others, others + 3, nfree);
+                    for (int k = 0; k < 4; ++k) {
+                        int other = number[this->box_edges[4 * box + k]];
+                        if (other >= 0 && other != j) {
+                            mask |= ((uint64_t)1) << (other & 63);
+                            *others++ = other;
+                        }
+                    }
+                }
+            });
+
+    // the order of play starts anywhere, each playout reshuffles it
+    for (int l = 0; l < LANES; ++l) {
+        for (int j = 0; j < nfree; ++j) {
+            uniform_order[l * nfree + j] = j;
+    }
+    for (int j = 0; j < nfree && j < 64; ++j) {
+        for (int l = 0; l < LANES; ++l)
+            lane_order[j * LANES + l] = j;
+        }
+    }
+}
+
+PlayoutEngine::Result PlayoutEngine::run(const Board &board, int nplayouts, Random &random,
+        int player, PlayoutPolicy policy)
+{
+    int lead = board.get_score(player) - board.get_score(!player);
+    Result result = {0, 0, 0, 0};
+    int nfree = board.num_free_edges(), nsafe = 0;
+
+    if (policy == PLAYOUT_UNIFORM) {
+        setup_uniform(board);
+    } else {
+        nfree = 0;
+        board.for_each_move(MOVE_SAFE, [&] (Edge edge)
+                { this->free_edges[nfree++] = board.edge_index(edge); });
+        nsafe = nfree;
+        board.for_each_move(MOVE_CAPTURE, [&] (Edge edge)
+                { this->free_edges[nfree++] = board.edge_index(edge); });
+        board.for_each_move(MOVE_SACRIFICE, [&] (Edge edge)
+                { this->free_edges[nfree++] = board.edge_index(edge); });
+
+        board.for_each_node([&] (Node node)
+                {
+                    this->base_sides[node.y * board.get_width() + node.x] =
+                        4 - board.degree(node);
+                });
+    }
+
+    static bool has_avx512 = (__builtin_cpu_init(), __builtin_cpu_supports("avx512f"));
+    static bool has_bmi2 = __builtin_cpu_supports("bmi2");
+    LaneRandom lanes(random);
+    for (; result.playouts < nplayouts; result.playouts += LANES) {
+        int diffs[LANES];
+        if (policy == PLAYOUT_NOCHEAP)
+            nocheap_lanes(nfree, nsafe, random, diffs);
+        else if (nfree <= 64 && has_avx512)
+            uniform_vector_lanes(nfree, lanes, diffs);
+        else if (nfree <= 64 && has_bmi2)
+            uniform_word_lanes(nfree, lanes, diffs);
+        else
+            uniform_lanes(nfree, lanes, diffs);
+
+        for (int l = 0; l < LANES; ++l) {
+            result.score_diff += diffs[l];
+            result.wins += lead + diffs[l] > 0;
+            result.ties += lead + diffs[l] == 0;
+        }
+    }
+
+    return result;
+}
+
+// plays one uniform game in every lane with at most 64 free edges, setting
+// diffs to the score differences for the player to move at the start. The
+// edge a lane plays is the j-th of its free edges, which pdep picks out of
+// the bitboard without an order of play to keep.
+__attribute__((target("bmi2")))
+void PlayoutEngine::uniform_word_lanes(int nfree, LaneRandom &rng, int *diffs)
+{
+    const uint64_t *masks = &other_masks[0];
+    uint64_t filled[LANES];
+    int sign[LANES];
+    for (int l = 0; l < LANES; ++l) {
+        filled[l] = 0;
+        sign[l] = 1;
+        diffs[l] = 0;
+    }
+
+    for (int step = 0; step < nfree; ++step) {
+        LaneRandom::Words r;
+        rng.next(r);
+        uint64_t left = nfree - step;
+        for (int l = 0; l < LANES; ++l) {
+            uint64_t j = ((r[l] >> 32) * left) >> 32;
+            uint64_t bit = _pdep_u64(((uint64_t)1) << j, ~filled[l]);
+            int edge = __builtin_ctzll(bit);
+            uint64_t side0 = masks[2 * edge], side1 = masks[2 * edge + 1];
+
+            int took = ((filled[l] & side0) == side0) + ((filled[l] & side1) == side1);
+            filled[l] |= bit;
+
+            diffs[l] += sign[l] * took;
+            // the same player goes again after taking a box
+            sign[l] = took ? sign[l] : -sign[l];
+        }
+    }
+}
+
+// the same with AVX-512, eight lanes' state to a register and the lanes in
+// GROUPS registers whose steps are independent, so one group's gathers wait
+// while another's go. The lanes keep their orders of play as in
+// uniform_lanes, interleaved so a step's slots are next to each other.
+__attribute__((target("avx512f")))
+void PlayoutEngine::uniform_vector_lanes(int nfree, LaneRandom &rng, int *diffs)
+{
+    static const int GROUPS = LANES / 8;
+    long long *order = &lane_order[0];
+    const long long *masks = (const long long *)&other_masks[0];
+    long long *state = (long long *)rng.s;
+
+    const __m512i one = _mm512_set1_epi64(1);
+    __m512i s[4][GROUPS], lane[GROUPS];
+    // negate is -1 while the player who was to move at the start isn't
+    __m512i filled[GROUPS], diff[GROUPS], negate[GROUPS];
+    for (int g = 0; g < GROUPS; ++g) {
+        for (int k = 0; k < 4; ++k)
+            s[k][g] = _mm512_loadu_si512(&state[k * LANES + 8 * g]);
+        lane[g] = _mm512_set_epi64(8 * g + 7, 8 * g + 6, 8 * g + 5, 8 * g + 4,
+                8 * g + 3, 8 * g + 2, 8 * g + 1, 8 * g);
+        filled[g] = diff[g] = negate[g] = _mm512_setzero_si512();
+    }
+
+    for (int step = 0; step < nfree; ++step) {
+        __m512i left = _mm512_set1_epi64(nfree - step), start = _mm512_set1_epi64(step);
+#pragma GCC unroll 4
+        for (int g = 0; g < GROUPS; ++g) {
+            __m512i r = _mm512_add_epi64(s[1][g], _mm512_slli_epi64(s[1][g], 2));
+            r = _mm512_rol_epi64(r, 7);
+            r = _mm512_add_epi64(r, _mm512_slli_epi64(r, 3));
+            __m512i t = _mm512_slli_epi64(s[1][g], 17);
+            s[2][g] = _mm512_xor_si512(s[2][g], s[0][g]);
+            s[3][g] = _mm512_xor_si512(s[3][g], s[1][g]);
+            s[1][g] = _mm512_xor_si512(s[1][g], s[2][g]);
+            s[0][g] = _mm512_xor_si512(s[0][g], s[3][g]);
+            s[2][g] = _mm512_xor_si512(s[2][g], t);
+            s[3][g] = _mm512_rol_epi64(s[3][g], 45);
+
+            __m512i j = _mm512_mul_epu32(_mm512_srli_epi64(r, 32), left);
+            j = _mm512_add_epi64(_mm512_srli_epi64(j, 32), start);
+            __m512i slot = _mm512_add_epi64(_mm512_mul_epu32(j, _mm512_set1_epi64(LANES)), lane[g]);
+
+            long long *here = &order[step * LANES + 8 * g];
+            __m512i first = _mm512_loadu_si512(here);
+            __m512i edge = _mm512_i64gather_epi64(slot, order, 8);
+            _mm512_i64scatter_epi64(order, slot, first, 8);
+            _mm512_storeu_si512(here, edge);
+
+            __m512i side = _mm512_slli_epi64(edge, 1);
+            __m512i side0 = _mm512_i64gather_epi64(side, masks, 8);
+            __m512i side1 = _mm512_i64gather_epi64(_mm512_add_epi64(side, one), masks, 8);
+            __mmask8 took0 = _mm512_cmpeq_epi64_mask(_mm512_and_si512(filled[g], side0), side0);
+            __mmask8 took1 = _mm512_cmpeq_epi64_mask(_mm512_and_si512(filled[g], side1), side1);
+            filled[g] = _mm512_or_si512(filled[g], _mm512_sllv_epi64(one, edge));
+
+            __m512i took = _mm512_add_epi64(_mm512_maskz_mov_epi64(took0, one),
+                    _mm512_maskz_mov_epi64(took1, one));
+            diff[g] = _mm512_add_epi64(diff[g],
+                    _mm512_sub_epi64(_mm512_xor_si512(took, negate[g]), negate[g]));
+            // the same player goes again after taking a box
+            negate[g] = _mm512_mask_xor_epi64(negate[g], (__mmask8)~(took0 | took1),
+                    negate[g], _mm512_set1_epi64(-1));
+        }
+    }
+
+    long long lanes[LANES];
+    for (int g = 0; g < GROUPS; ++g) {
+        for (int k = 0; k < 4; ++k)
+            _mm512_storeu_si512(&state[k * LANES + 8 * g], s[k][g]);
+        _mm512_storeu_si512(&lanes[8 * g], diff[g]);
+    }
+    for (int l = 0; l < LANES; ++l)
+        diffs[l] = lanes[l];
+}
+
+// the same for any number of free edges, with each lane's bitboard in nwords
+// words and a shuffled order of play to pick its edges from
+void PlayoutEngine::uniform_lanes(int nfree, LaneRandom &rng, int *diffs)
+{
+    int *order = &uniform_order[0];
+    uint64_t *filled = &this->filled[0];
+    const int *others = &other_edges[0];
+
+    std::fill(filled, filled + nwords * LANES, 0);
+    for (int l = 0; l < LANES; ++l)
+        filled[l * nwords + nfree / 64] |= ((uint64_t)1) << (nfree & 63);
+
+    int sign[LANES];
+    for (int l = 0; l < LANES; ++l) {
+        sign[l] = 1;
+        diffs[l] = 0;
+    }
+
+    for (int step = 0; step < nfree; ++step) {
+        LaneRandom::Words r;
+        rng.next(r);
+        uint64_t left = nfree - step;
+        for (int l = 0; l < LANES; ++l) {
+            int *lane = &order[l * nfree];
+            uint64_t *bits = &filled[l * nwords];
+            int j = step + (int)(((r[l] >> 32) * left) >> 32);
+            int edge = lane[j];
+            lane[j] = lane[step];
+            lane[step] = edge;
+
+            const int *other = &others[6 * edge];
+            int took = 0;
+            for (int side = 0; side < 2; ++side, other += 3) {
+                int all = 1;
+                for (int k = 0; k < 3; ++k)
+                    all &= bits[other[k] >> 6] >> (other[k] & 63);
+                took += all;
+            }
+            bits[edge >> 6] |= ((uint64_t)1) << (edge & 63);
+
+            diffs[l] += sign[l] * took;
+            sign[l] = took ? sign[l] : -sign[l];
+        }
+    }
+}
+
+// plays one nocheap game in every lane, setting diffs to the score
+// differences for the player to move at the start
+void PlayoutEngine::nocheap_lanes(int nfree, int nsafe, Random &random, int *diffs)
+{
+    // locals so the compiler knows the stores into one don't change the others
+    int *order = &this->order[0], *slot = &this->slot[0];
+    int *sides = &this->sides[0], *ready = &this->ready[0];
+    const int *edge_boxes = &this->edge_boxes[0], *box_edges = &this->box_edges[0];
+
+    // filled edges have no slot
+    std::fill(slot, slot + nedges * LANES, -1);
+    for (int i = 0; i < nfree; ++i) {
+        std::fill(&order[i * LANES], &order[i * LANES] + LANES, free_edges[i]);
+        std::fill(&slot[free_edges[i] * LANES], &slot[free_edges[i] * LANES] + LANES, i);
+    }
+
+    int nready0 = 0;
+    for (int b = 0; b <= nboxes; ++b) {
+        std::fill(&sides[b * LANES], &sides[b * LANES] + LANES, base_sides[b]);
+        if (base_sides[b] == 1) {
+            std::fill(&ready[nready0 * LANES], &ready[nready0 * LANES] + LANES, b);
+            ++nready0;
+        }
+    }
+
+    // sign is +1 while the player who was to move at the start is moving,
+    // the safe edges are in the slots before safe_end
+    int sign[LANES], nready[LANES], safe_end[LANES];
+    for (int l = 0; l < LANES; ++l) {
+        sign[l] = 1;
+        diffs[l] = 0;
+        nready[l] = nready0;
+        safe_end[l] = nsafe;
+    }
+
+    auto put = [&] (int l, int s, int edge)
+    {
+        order[s * LANES + l] = edge;
+        slot[edge * LANES + l] = s;
+    };
+
+    Random rng = random;
+    for (int step = 0; step < nfree; ++step) {
+        for (int l = 0; l < LANES; ++l) {
+            // the slot of the edge to play: a box to take, then a safe edge
+            int j = -1;
+            while (nready[l] > 0 && j < 0) {
+                int box = ready[--nready[l] * LANES + l];
+                if (sides[box * LANES + l] != 1)
+                    continue;
+                for (int k = 0; k < 4; ++k) {
+                    int s = slot[box_edges[4 * box + k] * LANES + l];
+                    if (s >= step)
+                        j = s;
+                }
+            }
+            if (j < 0 && safe_end[l] > step)
+                j = step + rng.below(safe_end[l] - step);
+            else if (j < 0)
+                j = step + rng.below(nfree - step);
+
+            int first = order[step * LANES + l], edge = order[j * LANES + l];
+            if (j >= safe_end[l] && safe_end[l] > step) {
+                // an unsafe edge played while safe ones are left, so the
+                // first safe edge moves to the end of the safe ones
+                int next_unsafe = order[safe_end[l] * LANES + l];
+                put(l, j, next_unsafe);
+                put(l, safe_end[l], first);
+                ++safe_end[l];
+            } else {
+                put(l, j, first);
+            }
+            put(l, step, edge);
+            safe_end[l] = std::max(safe_end[l], step + 1);
+
+            int took = 0;
+            for (int side = 0; side < 2; ++side) {
+                int box = edge_boxes[2 * edge + side];
+                int left = --sides[box * LANES + l];
+                took += left == 0;
+                if (left == 1) {
+                    ready[nready[l]++ * LANES + l] = box;
+                } else if (left == 2) {
+                    // the box's other free edges give it away now
+                    for (int k = 0; k < 4; ++k) {
+                        int s = slot[box_edges[4 * box + k] * LANES + l];
+                        if (s > step && s < safe_end[l]) {
+                            int last = --safe_end[l];
+                            int moved = order[last * LANES + l];
+                            put(l, last, box_edges[4 * box + k]);
+                            put(l, s, moved);
+                        }
+                    }
+                }
+            }
+
+            diffs[l] += sign[l] * took;
+            // the same player goes again after taking a box
+            sign[l] = took ? sign[l] : -sign[l];
+        }
+    }
+    random = rng;
+}
@@ -0,0 +1,93 @@
+#ifndef PLAYOUT_H
+#define PLAYOUT_H
+
+#include "Board.h"
+#include "Random.h"
+
+#include <vector>
+#include <stdint.h>
+
+struct LaneRandom;
+
+enum PlayoutPolicy
+{
+    PLAYOUT_UNIFORM, // every free edge is as likely as any other
+    PLAYOUT_NOCHEAP // take a box, else a safe edge, else any edge
+};
+
+// Plays games to the end in process, LANES at a time, interleaved step by
+// step with every lane's state laid out next to the other lanes' so the
+// lanes' work is independent and overlaps in the pipeline.
+//
+// Uniform playouts number the board's free edges from 0 and keep each lane's
+// filled edges as a bitboard, with the lanes' random numbers drawn together
+// in vector registers. With at most 64 free edges and BMI2 a lane plays the
+// j-th of its free edges straight from the bitboard with pdep. Otherwise
+// each lane plays its free edges in a random order, swapping a random one of
+// the edges left into place every step (a Fisher-Yates shuffle done a step at
+// a time). An edge takes a box when the box's other free edges are all
+// filled, which is one masked compare per side of the edge.
+//
+// Nocheap playouts are the stronger policy: uniformly random moves sacrifice
+// boxes so often that their results say little about the position. The
+// shuffle there keeps the safe edges first among the ones left, and each box
+// counts down its free sides; the edge that takes the count to 2 makes the
+// box's other edges unsafe, to 1 makes the box takeable and to 0 takes it.
+class PlayoutEngine
+{
+    public:
+        static const int LANES = 16;
+
+        struct Result
+        {
+            long playouts;
+            long score_diff; // summed over the playouts
+            long wins, ties;
+        };
+
+        // the engine only depends on the board's size
+        PlayoutEngine(int width, int height);
+
+        // plays nplayouts (rounded up to a multiple of LANES) games from
+        // board with player to move. Score differences are for that player
+        // and only count boxes taken during the playouts; wins and ties also
+        // count the boxes the board's players already have.
+        Result run(const Board &board, int nplayouts, Random &random, int player = 0,
+                PlayoutPolicy policy = PLAYOUT_NOCHEAP);
+
+    private:
+        void setup_uniform(const Board &board);
+        void uniform_word_lanes(int nfree, LaneRandom &rng, int *diffs);
+        void uniform_vector_lanes(int nfree, LaneRandom &rng, int *diffs);
+        void uniform_lanes(int nfree, LaneRandom &rng, int *diffs);
+        void nocheap_lanes(int nfree, int nsafe, Random &random, int *diffs);
+
+        int nedges, nboxes;
+        // both boxes of each edge. Border edges have the extra box nboxes on
+        // their outside, which starts with more sides than there are edges so
+        // it is never completed and the lanes don't branch on it.
+        std::vector<int> edge_boxes;
+        std::vector<int> box_edges; // the four edges of each box
+
+        // Uniform state, by the free edges' own numbers. For each side of
+        // an edge the box's other free edges, as a mask with at most 64
+        // free edges and otherwise as three numbers padded with one that is
+        // always filled; the ground's side has the edge itself, which is
+        // never filled yet when it is tested.
+        std::vector<uint64_t> other_masks;
+        std::vector<int> other_edges;
+        // each lane's order of play, lane l's at l * nfree
+        std::vector<int> uniform_order;
+        std::vector<long long> lane_order; // slot j of lane l at j * LANES + l
+        std::vector<uint64_t> filled; // lane l's words at l * nwords
+        int nwords;
+
+        // Nocheap state. free_edges has the safe edges first. The rest is
+        // scratch state, lane l of item i is at i * LANES + l
+        std::vector<int> free_edges, order, slot; // slot is order's inverse
+        std::vector<int> base_sides, sides; // free sides of each box
+        // boxes that were down to one side when pushed
+        std::vector<int> ready;
+};
+
+#endif
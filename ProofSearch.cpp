@@ -0,0 +1,408 @@
+#include "Board.h"
+#include "StringsAndCoins.h"
+
+#include <algorithm>
+#include <vector>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <stdint.h>
+
+#include <unistd.h>
+#include <sys/time.h>
+
+static void usage()
+{
+    printf("USAGE: ./proof_search [-m megabytes] < board\n"
+            "  -m  memory for the transposition table (256 by default)\n"
+            "Reads a board as the move deciders do and prints whether the player to move\n"
+            "wins, loses or draws with best play.\n");
+
+    exit(1);
+}
+
+static const uint32_t INF = 1 << 30;
+
+static uint32_t add_capped(uint32_t a, uint32_t b)
+{
+    return std::min(a + b, INF);
+}
+
+struct PnEntry
+{
+    uint64_t key; // 0 if empty
+    uint32_t pn, dn;
+    uint32_t work; // nodes searched below the entry, capped
+    uint32_t pad;
+};
+
+// Proof and disproof numbers in a fixed amount of memory, four entries to a
+// bucket. Once it is mostly full the entries with the least work under them,
+// which are the cheapest to find again, are thrown away until half of it is
+// free. A store to a bucket that is still full replaces its smallest entry.
+class PnTable
+{
+    public:
+        PnTable(size_t bytes);
+
+        bool lookup(uint64_t key, uint32_t &pn, uint32_t &dn) const;
+        void store(uint64_t key, uint32_t pn, uint32_t dn, uint32_t work);
+        void clear();
+
+        unsigned long num_collections() const { return collections; }
+
+    private:
+        static const int SLOTS = 4;
+
+        void collect();
+        static int work_class(uint32_t work) { return 32 - __builtin_clz(work | 1); }
+
+        std::vector<PnEntry> entries;
+        size_t nbuckets; // a power of 2
+        size_t used;
+        unsigned long collections;
+};
+
+PnTable::PnTable(size_t bytes) :
+    used(0), collections(0)
+{
+    nbuckets = 1;
+    while (nbuckets * 2 * SLOTS * sizeof(PnEntry) <= bytes)
+        nbuckets *= 2;
+    PnEntry empty = {0, 0, 0, 0, 0};
+    entries.assign(nbuckets * SLOTS, empty);
+}
+
+void PnTable::clear()
+{
+    PnEntry empty = {0, 0, 0, 0, 0};
+    std::fill(entries.begin(), entries.end(), empty);
+    used = 0;
+}
+
+bool PnTable::lookup(uint64_t key, uint32_t &pn, uint32_t &dn) const
+{
+    const PnEntry *bucket = &entries[(key & (nbuckets - 1)) * SLOTS];
+    for (int i = 0; i < SLOTS; ++i) {
+        if (bucket[i].key == key) {
+            pn = bucket[i].pn;
+            dn = bucket[i].dn;
+            return true;
+        }
+    }
+    return false;
+}
+
+void PnTable::store(uint64_t key, uint32_t pn, uint32_t dn, uint32_t work)
+{
+    if (used >= entries.size() / 10 * 9)
+        collect();
+
+    PnEntry *bucket = &entries[(key & (nbuckets - 1)) * SLOTS];
+    PnEntry *slot = NULL;
+    for (int i = 0; i < SLOTS && !slot; ++i) {
+        if (bucket[i].key == key)
+            slot = &bucket[i];
+    }
+    for (int i = 0; i < SLOTS && !slot; ++i) {
+        if (bucket[i].key == 0) {
+            slot = &bucket[i];
+            ++used;
+        }
+    }
+    if (!slot) {
+        slot = &bucket[0];
+        for (int i = 1; i < SLOTS; ++i) {
+            if (bucket[i].work < slot->work)
+                slot = &bucket[i];
+        }
+    }
+
+    slot->key = key;
+    slot->pn = pn;
+    slot->dn = dn;
+    slot->work = work;
+}
+
+// frees the entries in the smallest classes of work (by powers of 2) that
+// make up at least half of the table
+void PnTable::collect()
+{
+    size_t count[33] = {};
+    for (size_t i = 0; i < entries.size(); ++i) {
+        if (entries[i].key)
+            ++count[work_class(entries[i].work)];
+    }
+
+    int limit = 0;
+    for (size_t freed = count[0]; freed < used / 2 && limit < 32; freed += count[++limit])
+        ;
+
+    for (size_t i = 0; i < entries.size(); ++i) {
+        if (entries[i].key && work_class(entries[i].work) <= limit) {
+            entries[i].key = 0;
+            --used;
+        }
+    }
+    ++collections;
+}
+
+// Depth-first proof-number search (df-pn) of whether the player to move at
+// the root ends up at least target boxes ahead. OR nodes have the root's
+// player to move, AND nodes the opponent; taking a box keeps the same kind
+// of node. A node is settled without searching when the boxes left can't
+// change the outcome, or when the position is a simple loony endgame whose
+// value StringsAndCoins knows.
+class ProofSearch
+{
+    public:
+        ProofSearch(const Board &board, PnTable &table);
+
+        // true if the player to move can finish target or more boxes ahead
+        bool prove(int target);
+
+        unsigned long num_nodes() const { return nodes; }
+
+    private:
+        struct Child
+        {
+            int move;
+            uint64_t key;
+            bool or_node;
+            int diff;
+            uint32_t pn, dn;
+        };
+
+        uint64_t key(bool or_node, int diff) const;
+        int forced_capture() const;
+        bool settle(bool or_node, int diff, uint32_t &pn, uint32_t &dn);
+        uint32_t mid(bool or_node, int diff, uint32_t thpn, uint32_t thdn,
+                uint32_t &pn, uint32_t &dn);
+
+        Board board;
+        PnTable &table;
+        std::vector<Edge> edges; // by edge_index
+        int target;
+        int remaining; // boxes not yet taken
+        unsigned long nodes;
+};
+
+ProofSearch::ProofSearch(const Board &board, PnTable &table) :
+    board(board), table(table), edges(board.num_edges()), target(0), remaining(0), nodes(0)
+{
+    Board empty(board.get_width(), board.get_height());
+    std::for_each(empty.edge_begin(), empty.edge_end(), [&] (Edge edge)
+            {
+                if (empty.is_move_valid(edge))
+                    this->edges[empty.edge_index(edge)] = edge;
+            });
+
+    board.for_each_node([&] (Node node)
+            { if (board.degree(node) < 4) ++this->remaining; });
+}
+
+// the same edges are different nodes with a different player to move or a
+// different lead so far
+uint64_t ProofSearch::key(bool or_node, int diff) const
+{
+    uint64_t key = board.get_hash() ^
+        (uint64_t)(diff + 0x10000) * 0x9E3779B97F4A7C15ULL ^
+        (or_node ? 0xD6E8FEB86659FD93ULL : 0);
+    return key ? key : 1;
+}
+
+// a capture that can't be part of a double deal, because the box on the
+// other side of it is the ground or doesn't become takeable, is always worth
+// taking right away, so it is the only move searched. -1 if there is none
+int ProofSearch::forced_capture() const
+{
+    int forced = -1;
+    board.for_each_move(MOVE_CAPTURE, [&] (Edge edge)
+            {
+                if (forced >= 0)
+                    return;
+                bool chain = false;
+                this->board.for_each_adjacent_node(edge, [&] (Node node)
+                    { if (this->board.degree(node) == 2) chain = true; });
+                if (!chain)
+                    forced = this->board.edge_index(edge);
+            });
+    return forced;
+}
+
+// sets pn and dn if the node's outcome is known without searching it
+bool ProofSearch::settle(bool or_node, int diff, uint32_t &pn, uint32_t &dn)
+{
+    int low = diff - remaining, high = diff + remaining;
+
+    if (low < target && high >= target &&
+            board.num_moves(MOVE_SAFE) == 0 && board.num_moves(MOVE_CAPTURE) == 0) {
+        StringsAndCoins coins(board);
+        if (coins.is_simple())
+            low = high = diff + (or_node ? coins.value() : -coins.value());
+    }
+
+    if (low >= target) {
+        pn = 0;
+        dn = INF;
+        return true;
+    }
+    if (high < target) {
+        pn = INF;
+        dn = 0;
+        return true;
+    }
+    return false;
+}
+
+// searches the node until its proof number reaches thpn or its disproof
+// number reaches thdn, leaving them in pn and dn and returning the work done
+uint32_t ProofSearch::mid(bool or_node, int diff, uint32_t thpn, uint32_t thdn,
+        uint32_t &pn, uint32_t &dn)
+{
+    ++nodes;
+    uint32_t work = 1;
+
+    std::vector<Child> children;
+    auto add_child = [&] (Edge edge)
+            {
+                Child child;
+                child.move = this->board.edge_index(edge);
+
+                int oldscore = this->board.get_score(0);
+                bool again = this->board.move(0, edge);
+                int took = this->board.get_score(0) - oldscore;
+                this->remaining -= took;
+
+                child.or_node = again ? or_node : !or_node;
+                child.diff = diff + (or_node ? took : -took);
+                child.key = this->key(child.or_node, child.diff);
+                if (!this->settle(child.or_node, child.diff, child.pn, child.dn) &&
+                        !this->table.lookup(child.key, child.pn, child.dn)) {
+                    child.pn = 1;
+                    child.dn = 1;
+                }
+
+                this->remaining += took;
+                this->board.unmove(0, edge);
+                children.push_back(child);
+            };
+
+    int forced = forced_capture();
+    if (forced >= 0)
+        add_child(edges[forced]);
+    else
+        board.for_each_move(add_child);
+
+    for (;;) {
+        // an OR node needs one child proved and every child disproved, an
+        // AND node the other way around
+        int best = 0;
+        uint32_t second = INF;
+        pn = or_node ? INF : 0;
+        dn = or_node ? 0 : INF;
+        for (size_t i = 0; i < children.size(); ++i) {
+            uint32_t own = or_node ? children[i].pn : children[i].dn;
+            uint32_t best_own = or_node ? children[best].pn : children[best].dn;
+            if (i > 0 && own < best_own) {
+                second = best_own;
+                best = i;
+            } else if (i > 0 && own < second) {
+                second = own;
+            }
+
+            if (or_node) {
+                pn = std::min(pn, children[i].pn);
+                dn = add_capped(dn, children[i].dn);
+            } else {
+                pn = add_capped(pn, children[i].pn);
+                dn = std::min(dn, children[i].dn);
+            }
+        }
+
+        if (pn >= thpn || dn >= thdn)
+            break;
+
+        // search the most promising child until it stops being that, with
+        // the 1 + epsilon trick's margin against bouncing between children
+        Child &child = children[best];
+        uint32_t child_thpn, child_thdn;
+        if (or_node) {
+            child_thpn = std::min(thpn, std::max(second, second + second / 4) + 1);
+            child_thdn = add_capped(thdn - dn, child.dn);
+        } else {
+            child_thpn = add_capped(thpn - pn, child.pn);
+            child_thdn = std::min(thdn, std::max(second, second + second / 4) + 1);
+        }
+        child_thpn = std::min(child_thpn, INF);
+        child_thdn = std::min(child_thdn, INF);
+
+        Edge edge = edges[child.move];
+        int oldscore = board.get_score(0);
+        board.move(0, edge);
+        int took = board.get_score(0) - oldscore;
+        remaining -= took;
+
+        uint32_t child_work = mid(child.or_node, child.diff, child_thpn, child_thdn,
+                child.pn, child.dn);
+        work = std::min(work + child_work, (uint32_t)UINT_MAX - 1);
+
+        remaining += took;
+        board.unmove(0, edge);
+    }
+
+    table.store(key(or_node, diff), pn, dn, work);
+    return work;
+}
+
+bool ProofSearch::prove(int target)
+{
+    this->target = target;
+    table.clear();
+
+    int diff = board.get_score(0) - board.get_score(1);
+    uint32_t pn, dn;
+    if (settle(true, diff, pn, dn))
+        return pn == 0;
+
+    mid(true, diff, INF, INF, pn, dn);
+    return pn == 0;
+}
+
+int main(int argc, char **argv)
+{
+    size_t megabytes = 256;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "m:")) != -1) {
+        switch (opt) {
+            case 'm': megabytes = atoi(optarg); break;
+            default: usage();
+        }
+    }
+
+    if (optind != argc || megabytes == 0)
+        usage();
+
+    Board board = read_board(stdin);
+    PnTable table(megabytes << 20);
+    ProofSearch search(board, table);
+
+    timeval start, end;
+    gettimeofday(&start, NULL);
+
+    // winning is finishing at least one box ahead, not losing at least level
+    const char *result;
+    if (search.prove(1))
+        result = "win";
+    else if (search.prove(0))
+        result = "draw";
+    else
+        result = "loss";
+
+    gettimeofday(&end, NULL);
+    printf("%s\n", result);
+    fprintf(stderr, "%lu nodes, %lu collections, %.3f seconds\n",
+            search.num_nodes(), table.num_collections(),
+            (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) / 1e6);
+}
@@ -0,0 +1,29 @@
+#include "Random.h"
+
+#include <cstdio>
+#include <cstdlib>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+static uint64_t initial_seed()
+{
+    const char *env = getenv("DOTS_SEED");
+    if (env)
+        return strtoull(env, NULL, 0);
+
+    uint64_t seed = 0;
+    int fd = open("/dev/urandom", O_RDONLY);
+    if (fd == -1 || read(fd, &seed, sizeof(seed)) != sizeof(seed)) {
+        perror("/dev/urandom");
+        exit(1);
+    }
+    close(fd);
+    return seed;
+}
+
+Random &process_random()
+{
+    static Random random(initial_seed());
+    return random;
+}
@@ -0,0 +1,53 @@
+#ifndef RANDOM_H
+#define RANDOM_H
+
+#include <stdint.h>
+
+// xoshiro256** seeded through splitmix64. Fast enough to call per move or per
+// playout step, and the same seed always gives the same numbers.
+class Random
+{
+    public:
+        explicit Random(uint64_t seed) { this->seed(seed); }
+
+        void seed(uint64_t seed);
+        uint64_t next();
+        // uniform in [0, n), n > 0
+        uint32_t below(uint32_t n) { return (uint32_t)(((next() >> 32) * n) >> 32); }
+
+    private:
+        static uint64_t rotl(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+
+        uint64_t s[4];
+};
+
+inline void Random::seed(uint64_t seed)
+{
+    for (int i = 0; i < 4; ++i) {
+        uint64_t z = (seed += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        s[i] = z ^ (z >> 31);
+    }
+}
+
+inline uint64_t Random::next()
+{
+    uint64_t result = rotl(s[1] * 5, 7) * 9;
+    uint64_t t = s[1] << 17;
+
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotl(s[3], 45);
+
+    return result;
+}
+
+// the generator the deciders share, seeded once per process from $DOTS_SEED
+// if it is set and from /dev/urandom otherwise
+Random &process_random();
+
+#endif
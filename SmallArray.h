@@ -0,0 +1,37 @@
+#ifndef SMALL_ARRAY_H
+#define SMALL_ARRAY_H
+
+#include <algorithm>
+#include <vector>
+
+// A fixed size array that lives inside the object when it has at most N
+// elements and on the heap otherwise, so copying one for a small board never
+// allocates.
+template<class T, int N>
+class SmallArray
+{
+    public:
+        SmallArray(int size = 0, T value = T()) :
+            n(size)
+        {
+            if (n > N)
+                large.assign(n, value);
+            else
+                std::fill(small, small + N, value);
+        }
+
+        int size() const { return n; }
+
+        T *data() { return n > N ? &large[0] : small; }
+        const T *data() const { return n > N ? &large[0] : small; }
+
+        T &operator[](int i) { return data()[i]; }
+        const T &operator[](int i) const { return data()[i]; }
+
+    private:
+        int n;
+        T small[N];
+        std::vector<T> large;
+};
+
+#endif
@@ -0,0 +1,154 @@
+#include "StringsAndCoins.h"
+
+#include <algorithm>
+#include <map>
+#include <cassert>
+
+StringsAndCoins::StringsAndCoins(const Board &board) :
+    simple(true)
+{
+    int width = board.get_width();
+    std::vector<bool> seen(width * board.get_height(), false);
+
+    auto strings = [&] (Node coin) { return 4 - board.degree(coin); };
+
+    // the coin on the other end of string from coin, or coin itself for the
+    // ground
+    auto across = [&] (Node coin, Edge string)
+    {
+        Node other = coin;
+        board.for_each_adjacent_node(string, [&] (Node node)
+                { if (node != coin) other = node; });
+        return other;
+    };
+
+    // the string of a two string coin other than string
+    auto other_string = [&] (Node coin, Edge string)
+    {
+        Edge other = string;
+        board.for_each_adjacent_edge(coin, [&] (Edge edge)
+                { if (board.is_move_valid(edge) && edge != string) other = edge; });
+        return other;
+    };
+
+    board.for_each_node([&] (Node start)
+            {
+                int n = strings(start);
+                if (n == 0 || seen[start.y * width + start.x])
+                    return;
+                if (n != 2) {
+                    this->simple = false;
+                    return;
+                }
+
+                Component comp = {false, true, 1, std::vector<Edge>()};
+                seen[start.y * width + start.x] = true;
+
+                Edge ends[2];
+                int nends = 0;
+                board.for_each_adjacent_edge(start, [&] (Edge edge)
+                    { if (board.is_move_valid(edge)) ends[nends++] = edge; });
+
+                // walk out from start both ways, the first way backwards
+                std::vector<Edge> half[2];
+                for (int side = 0; side < 2 && !comp.loop; ++side) {
+                    Node coin = start;
+                    Edge string = ends[side];
+                    while (true) {
+                        half[side].push_back(string);
+                        Node next = across(coin, string);
+                        if (next == coin)
+                            break; // the ground
+                        if (next == start) {
+                            comp.loop = true;
+                            break;
+                        }
+                        if (strings(next) != 2) {
+                            comp.isolated = false;
+                            break;
+                        }
+                        seen[next.y * width + next.x] = true;
+                        ++comp.length;
+                        coin = next;
+                        string = other_string(coin, string);
+                    }
+                }
+
+                comp.strings.assign(half[0].rbegin(), half[0].rend());
+                comp.strings.insert(comp.strings.end(), half[1].begin(), half[1].end());
+                if (!comp.isolated)
+                    this->simple = false;
+                this->comps.push_back(comp);
+            });
+}
+
+int StringsAndCoins::controlled_value() const
+{
+    int value = 0, nchains = 0, nloops = 0;
+    for (size_t i = 0; i < comps.size(); ++i) {
+        if (comps[i].loop) {
+            ++nloops;
+        } else if (comps[i].length >= 3) {
+            ++nchains;
+        } else {
+            continue;
+        }
+        value += comps[i].length;
+    }
+
+    if (nchains + nloops == 0)
+        return 0;
+    // the last component is taken whole, better a chain than a loop
+    return value - 4 * nchains - 8 * nloops + (nchains > 0 ? 4 : 8);
+}
+
+// Sizes of the components, loops negated. The player to move opens one; the
+// opponent takes it all and moves next, or for a long chain or a loop
+// leaves the last 2 or 4 coins to keep control. Short chains are opened so
+// they can't be split that way.
+typedef std::map<std::vector<int>, int> ValueCache;
+
+static int simple_value(const std::vector<int> &sizes, ValueCache &cache)
+{
+    if (sizes.empty())
+        return 0;
+
+    ValueCache::iterator it = cache.find(sizes);
+    if (it != cache.end())
+        return it->second;
+
+    int best = -1 << 30;
+    for (size_t i = 0; i < sizes.size(); ++i) {
+        if (i > 0 && sizes[i] == sizes[i - 1])
+            continue;
+
+        std::vector<int> rest(sizes);
+        rest.erase(rest.begin() + i);
+        int next = simple_value(rest, cache);
+
+        int n = sizes[i] < 0 ? -sizes[i] : sizes[i];
+        int opponent = n + next;
+        if (sizes[i] < 0)
+            opponent = std::max(opponent, n - 8 - next);
+        else if (n >= 3)
+            opponent = std::max(opponent, n - 4 - next);
+
+        best = std::max(best, -opponent);
+    }
+
+    cache[sizes] = best;
+    return best;
+}
+
+int StringsAndCoins::value() const
+{
+    assert(simple);
+
+    std::vector<int> sizes;
+    for (size_t i = 0; i < comps.size(); ++i)
+        sizes.push_back(comps[i].loop ? -comps[i].length : comps[i].length);
+    std::sort(sizes.begin(), sizes.end());
+
+    ValueCache cache;
+    return simple_value(sizes, cache);
+}
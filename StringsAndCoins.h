@@ -0,0 +1,55 @@
+#ifndef STRINGS_AND_COINS_H
+#define STRINGS_AND_COINS_H
+
+#include "Board.h"
+
+#include <vector>
+
+// A board as a strings-and-coins graph: every box still to be taken is a
+// coin, every free edge a string between the coins on either side of it or
+// between a coin and the ground off the edge of the board. A coin with two
+// strings sits in a chain or a loop, maximal runs of such coins found in one
+// pass over the board.
+//
+// The position is simple when every coin is in a chain running from the
+// ground to the ground or in a loop. Then every move opens one of them and
+// value() is the exact score difference the player to move gets from the
+// rest of the game.
+class StringsAndCoins
+{
+    public:
+        struct Component
+        {
+            bool loop;
+            // whether it can be played on its own: every loop, and chains with
+            // both ends on the ground rather than at a coin with 1 or 3+ strings
+            bool isolated;
+            int length; // coins
+            std::vector<Edge> strings; // in order along it
+        };
+
+        StringsAndCoins(const Board &board);
+
+        const std::vector<Component> &components() const { return comps; }
+        bool is_simple() const { return simple; }
+
+        // Berlekamp's controlled value for the player who keeps control
+        // through the long chains (3 or more coins) and loops: the coins in
+        // them, less 4 given back for each chain and 8 for each loop but the
+        // last. Chains of one or two coins are left out, they can't be
+        // declined so nobody keeps control through them; they only decide
+        // who has to open the first long one, which is what the nimstring
+        // value says. In a simple position with only long chains and loops
+        // the player to move gets exactly minus this when it is at least 2.
+        // Otherwise chains that end at a coin with 3 or more strings count
+        // as they stand, so it is an estimate.
+        int controlled_value() const;
+        // needs is_simple()
+        int value() const;
+
+    private:
+        std::vector<Component> comps;
+        bool simple;
+};
+
+#endif
@@ -0,0 +1,83 @@
+#include "Symmetry.h"
+
+#include <algorithm>
+#include <cassert>
+
+// transform t flips x if bit 0 is set, flips y if bit 1 is set and swaps x and
+// y (before flipping) if bit 2 is set, which is only a symmetry of square
+// boards
+BoardSymmetry::BoardSymmetry(const Board &board) :
+    board(board.get_width(), board.get_height()),
+    width(board.get_width()), height(board.get_height()),
+    nedges(board.num_edges()),
+    ntransforms(width == height ? 8 : 4),
+    edges(nedges)
+{
+    // the board member is empty, so every edge on the board is still valid
+    std::for_each(this->board.edge_begin(), this->board.edge_end(), [&] (Edge edge)
+            {
+                if (this->board.is_move_valid(edge))
+                    this->edges[this->board.edge_index(edge)] = edge;
+            });
+
+    perm.resize(ntransforms * nedges);
+    for (int t = 0; t < ntransforms; ++t) {
+        for (int i = 0; i < nedges; ++i)
+            perm[t * nedges + i] = this->board.edge_index(transform_uncached(t, edges[i]));
+    }
+
+    inverses.resize(ntransforms);
+    for (int t = 0; t < ntransforms; ++t) {
+        for (int u = 0; u < ntransforms; ++u) {
+            bool identity = true;
+            for (int i = 0; i < nedges && identity; ++i)
+                identity = perm[u * nedges + perm[t * nedges + i]] == i;
+            if (identity)
+                inverses[t] = u;
+        }
+    }
+
+    // the mask tables only cover boards whose edges fit in one word
+    if (nedges > 64)
+        return;
+
+    byte_masks.assign(ntransforms * 8 * 256, 0);
+    for (int t = 0; t < ntransforms; ++t) {
+        for (int byte = 0; byte < 8; ++byte) {
+            for (int value = 0; value < 256; ++value) {
+                uint64_t &mask = byte_masks[(t * 8 + byte) * 256 + value];
+                for (int bit = 0; bit < 8; ++bit) {
+                    int i = byte * 8 + bit;
+                    if ((value & (1 << bit)) && i < nedges)
+                        mask |= ((uint64_t)1) << perm[t * nedges + i];
+                }
+            }
+        }
+    }
+}
+
+Edge BoardSymmetry::transform(int t, Edge edge) const
+{
+    return edges[perm[t * nedges + board.edge_index(edge)]];
+}
+
+// maps both of the edge's dots and joins them back up
+Edge BoardSymmetry::transform_uncached(int t, Edge edge) const
+{
+    int x[2] = {edge.x, edge.dir == HORIZ ? edge.x + 1 : edge.x};
+    int y[2] = {edge.y, edge.dir == HORIZ ? edge.y : edge.y + 1};
+
+    for (int i = 0; i < 2; ++i) {
+        if (t & 4)
+            std::swap(x[i], y[i]);
+        if (t & 1)
+            x[i] = width - x[i];
+        if (t & 2)
+            y[i] = height - y[i];
+    }
+
+    if (y[0] == y[1])
+        return Edge(HORIZ, std::min(x[0], x[1]), y[0]);
+    else
+        return Edge(VERT, x[0], std::min(y[0], y[1]));
+}
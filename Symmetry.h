@@ -0,0 +1,66 @@
+#ifndef SYMMETRY_H
+#define SYMMETRY_H
+
+#include "Board.h"
+
+#include <vector>
+#include <stdint.h>
+
+// The symmetries of a board's dot grid: the 8 rotations and reflections of
+// the square (D4) when width == height, otherwise the 4 of the rectangle
+// (D2). Edge sets are bitmasks over Board::edge_index, so the mask functions
+// only work on boards with at most 64 edges; the edge functions work on any.
+class BoardSymmetry
+{
+    public:
+        BoardSymmetry(const Board &board);
+
+        int num_transforms() const { return ntransforms; }
+        int inverse(int t) const { return inverses[t]; }
+
+        Edge transform(int t, Edge edge) const;
+        uint64_t transform(int t, uint64_t mask) const;
+        // the edge_index the edge with edge_index i is mapped to
+        int transform_index(int t, int i) const { return perm[t * nedges + i]; }
+
+        // the smallest of the masks symmetric to mask, if transform isn't
+        // NULL it is set to a transform t with transform(t, mask) == result
+        uint64_t canonicalize(uint64_t mask, int *transform = NULL) const;
+
+    private:
+        Edge transform_uncached(int t, Edge edge) const;
+
+        Board board;
+        int width, height, nedges, ntransforms;
+        std::vector<Edge> edges; // by edge_index
+        std::vector<int> perm; // ntransforms * nedges edge_index permutation
+        std::vector<int> inverses;
+        std::vector<uint64_t> byte_masks; // transformed mask of each byte value
+};
+
+inline uint64_t BoardSymmetry::transform(int t, uint64_t mask) const
+{
+    const uint64_t *table = &byte_masks[t * 8 * 256];
+    uint64_t ret = 0;
+    for (int byte = 0; mask; ++byte, mask >>= 8)
+        ret |= table[byte * 256 + (mask & 0xff)];
+    return ret;
+}
+
+inline uint64_t BoardSymmetry::canonicalize(uint64_t mask, int *transform) const
+{
+    uint64_t best = mask;
+    int best_t = 0;
+    for (int t = 1; t < ntransforms; ++t) {
+        uint64_t tmask = this->transform(t, mask);
+        if (tmask < best) {
+            best = tmask;
+            best_t = t;
+        }
+    }
+    if (transform)
+        *transform = best_t;
+    return best;
+}
+
+#endif
@@ -0,0 +1,114 @@
+#include "Tablebase.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+void write_tablebase(const char *path, const Board &board, const PackedTable &table)
+{
+    TablebaseHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, TABLEBASE_MAGIC, sizeof(header.magic));
+    header.version = TABLEBASE_VERSION;
+    header.width = board.get_width();
+    header.height = board.get_height();
+    header.lane_bits = table.lane_bits();
+    header.entries = table.size();
+    header.words = table.num_words();
+
+    FILE *fp = fopen(path, "wb");
+    if (!fp || fwrite(&header, sizeof(header), 1, fp) != 1 ||
+            fwrite(table.data(), sizeof(uint64_t), table.num_words(), fp) != table.num_words() ||
+            fclose(fp) != 0) {
+        perror(path);
+        exit(1);
+    }
+}
+
+Tablebase::Tablebase(const char *path)
+{
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd == -1 || fstat(fd, &st) == -1) {
+        perror(path);
+        exit(1);
+    }
+
+    map_size = st.st_size;
+    if (map_size < sizeof(TablebaseHeader)) {
+        fprintf(stderr, "%s is too short to be a tablebase\n", path);
+        exit(1);
+    }
+
+    map = mmap(NULL, map_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        perror(path);
+        exit(1);
+    }
+
+    header = (const TablebaseHeader *)map;
+    if (memcmp(header->magic, TABLEBASE_MAGIC, sizeof(header->magic)) != 0 ||
+            header->version != TABLEBASE_VERSION) {
+        fprintf(stderr, "%s is not a version %u tablebase\n", path, TABLEBASE_VERSION);
+        exit(1);
+    }
+
+    Board board(header->width, header->height);
+    int nboxes = header->width * header->height;
+    if (board.num_edges() >= 64 ||
+            header->entries != ((uint64_t)1) << board.num_edges() ||
+            header->lane_bits != (uint32_t)PackedTable::lane_bits(nboxes) ||
+            map_size < sizeof(TablebaseHeader) + header->words * sizeof(uint64_t)) {
+        fprintf(stderr, "%s is corrupt\n", path);
+        exit(1);
+    }
+
+    table = new PackedTable(nboxes, header->entries, (const uint64_t *)(header + 1));
+}
+
+Tablebase::~Tablebase()
+{
+    delete table;
+    munmap(map, map_size);
+}
+
+// the tablebase for the board's size, from $DOTS_TABLEBASE_DIR (or the current
+// directory) named <width>x<height>.tb. It stays mapped for the rest of the
+// process.
+static const Tablebase &tablebase_for(const Board &board)
+{
+    static Tablebase *tablebase = NULL;
+
+    if (tablebase && (tablebase->get_width() != board.get_width() ||
+                tablebase->get_height() != board.get_height())) {
+        delete tablebase;
+        tablebase = NULL;
+    }
+
+    if (!tablebase) {
+        const char *dir = getenv("DOTS_TABLEBASE_DIR");
+        char path[4096];
+        snprintf(path, sizeof(path), "%s/%dx%d.tb", dir ? dir : ".",
+                board.get_width(), board.get_height());
+        tablebase = new Tablebase(path);
+    }
+
+    return *tablebase;
+}
+
+// plays perfectly by looking up the score of every move in a tablebase
+// written by brute_force -o
+Edge Board::decide_move_perfect()
+{
+    const Tablebase &tablebase = tablebase_for(*this);
+
+    return solve_position(*this, edge_mask(), [&] (unsigned long nextIdx)
+            { return tablebase.score(nextIdx); }).first;
+}
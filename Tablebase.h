@@ -0,0 +1,88 @@
+#ifndef TABLEBASE_H
+#define TABLEBASE_H
+
+#include "Board.h"
+#include "PackedTable.h"
+
+#include <algorithm>
+#include <utility>
+#include <climits>
+#include <stdint.h>
+
+// A tablebase file is a TablebaseHeader followed by the words of a
+// PackedTable holding the score difference for the player to move in every
+// position of a width x height board, indexed by Board::edge_mask(). Numbers
+// are stored in the byte order of the machine that wrote the file.
+struct TablebaseHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t width, height;
+    uint32_t lane_bits;
+    uint64_t entries;
+    uint64_t words;
+    char reserved[24]; // pads the table out to a cache line
+};
+
+const char TABLEBASE_MAGIC[8] = {'D', 'O', 'T', 'S', 'T', 'B', '\0', '\0'};
+const uint32_t TABLEBASE_VERSION = 1;
+
+void write_tablebase(const char *path, const Board &board, const PackedTable &table);
+
+// a tablebase file mapped read only, so any number of processes share the
+// pages and opening it costs nothing up front
+class Tablebase
+{
+    public:
+        Tablebase(const char *path);
+        ~Tablebase();
+
+        int get_width() const { return header->width; }
+        int get_height() const { return header->height; }
+        int score(uint64_t idx) const { return table->get(idx); }
+
+    private:
+        Tablebase(const Tablebase &);
+        Tablebase &operator=(const Tablebase &);
+
+        void *map;
+        size_t map_size;
+        const TablebaseHeader *header;
+        PackedTable *table;
+};
+
+// finds the best move for player 0 in board, whose filled edges are idx.
+// next_score(nextIdx) gives the expected score difference for the player to
+// move after each valid move
+template<class F>
+std::pair<Edge, short> solve_position(Board &board, unsigned long idx, F next_score)
+{
+    Edge bestMove(HORIZ, -1, -1);
+    int bestScoreDiff = INT_MIN;
+
+    board.for_each_move([&] (Edge edge)
+            {
+                unsigned long nextIdx = idx | (((unsigned long)1) << board.edge_index(edge));
+                int oldScore = board.get_score(0);
+                bool tookSquare = board.move(0, edge);
+                if (tookSquare) {
+                    int nextScore = board.get_score(0) - oldScore + next_score(nextIdx);
+                    if (nextScore > bestScoreDiff) {
+                        bestScoreDiff = nextScore;
+                        bestMove = edge;
+                    }
+
+                } else {
+                    int nextScore = -next_score(nextIdx);
+                    if (nextScore > bestScoreDiff) {
+                        bestScoreDiff = nextScore;
+                        bestMove = edge;
+                    }
+                }
+                board.unmove(0, edge);
+            });
+
+    return std::make_pair(bestMove, (short)bestScoreDiff);
+}
+
+#endif
@@ -0,0 +1,140 @@
+#include "TranspositionTable.h"
+
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <sys/mman.h>
+
+static const size_t HUGE_PAGE = 2 << 20;
+
+TranspositionTable::TranspositionTable(size_t bytes) :
+    generation(0)
+{
+    nbuckets = 1;
+    while (nbuckets * 2 * sizeof(Bucket) <= bytes)
+        nbuckets *= 2;
+
+    // a mapping of whole huge pages, from the reserved pool if there is one
+    // and otherwise with transparent huge pages asked for
+    map_size = (size_bytes() + HUGE_PAGE - 1) / HUGE_PAGE * HUGE_PAGE;
+    void *map = MAP_FAILED;
+#ifdef MAP_HUGETLB
+    map = mmap(NULL, map_size, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#endif
+    if (map == MAP_FAILED) {
+        map = mmap(NULL, map_size, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (map == MAP_FAILED) {
+            perror("transposition table");
+            exit(1);
+        }
+#ifdef MADV_HUGEPAGE
+        madvise(map, map_size, MADV_HUGEPAGE);
+#endif
+    }
+
+    // anonymous pages start out zeroed, which is every slot empty
+    buckets = (Bucket *)map;
+}
+
+TranspositionTable::~TranspositionTable()
+{
+    munmap(buckets, map_size);
+}
+
+void TranspositionTable::clear()
+{
+    memset(buckets, 0, size_bytes());
+    generation = 0;
+}
+
+// value, move, depth, flag and generation a byte or two each, with the top
+// bit set so no entry packs to 0
+uint64_t TranspositionTable::pack(const TTEntry &entry, int generation)
+{
+    return (uint64_t)(uint16_t)entry.value |
+        (uint64_t)(uint16_t)entry.move << 16 |
+        (uint64_t)(uint8_t)entry.depth << 32 |
+        (uint64_t)entry.flag << 40 |
+        (uint64_t)generation << 48 |
+        (uint64_t)1 << 63;
+}
+
+TTEntry TranspositionTable::unpack(uint64_t data)
+{
+    TTEntry entry;
+    entry.value = (short)(uint16_t)data;
+    entry.move = (short)(uint16_t)(data >> 16);
+    entry.depth = (signed char)(uint8_t)(data >> 32);
+    entry.flag = (unsigned char)(data >> 40);
+    return entry;
+}
+
+// how many searches ago a slot was stored
+int TranspositionTable::age(uint64_t data, int generation)
+{
+    return (generation - (int)(data >> 48 & 0xff)) & 0xff;
+}
+
+bool TranspositionTable::probe(uint64_t key, TTEntry &entry) const
+{
+    const Bucket &bucket = buckets[key & (nbuckets - 1)];
+    for (int i = 0; i < SLOTS; ++i) {
+        uint64_t data = __atomic_load_n(&bucket.slots[i].data, __ATOMIC_RELAXED);
+        uint64_t check = __atomic_load_n(&bucket.slots[i].check, __ATOMIC_RELAXED);
+        if (data != 0 && (check ^ data) == key) {
+            entry = unpack(data);
+            return true;
+        }
+    }
+    return false;
+}
+
+void TranspositionTable::store(uint64_t key, const TTEntry &entry)
+{
+    Bucket &bucket = buckets[key & (nbuckets - 1)];
+
+    uint64_t old[SLOTS];
+    int victim = -1;
+    for (int i = 0; i < SLOTS; ++i) {
+        old[i] = __atomic_load_n(&bucket.slots[i].data, __ATOMIC_RELAXED);
+        uint64_t check = __atomic_load_n(&bucket.slots[i].check, __ATOMIC_RELAXED);
+        if (old[i] != 0 && (check ^ old[i]) == key) {
+            if (entry.depth < unpack(old[i]).depth && age(old[i], generation) == 0)
+                return;
+            victim = i;
+            break;
+        }
+    }
+
+    if (victim < 0) {
+        int victim_score = INT_MAX;
+        for (int i = 0; i < SLOTS; ++i) {
+            int score = old[i] == 0 ? INT_MIN :
+                unpack(old[i]).depth - 8 * age(old[i], generation);
+            if (score < victim_score) {
+                victim = i;
+                victim_score = score;
+            }
+        }
+    }
+
+    uint64_t data = pack(entry, generation);
+    __atomic_store_n(&bucket.slots[victim].data, data, __ATOMIC_RELAXED);
+    __atomic_store_n(&bucket.slots[victim].check, key ^ data, __ATOMIC_RELAXED);
+}
+
+static size_t initial_size()
+{
+    const char *mb = getenv("DOTS_TT_MB");
+    return (size_t)(mb ? atoi(mb) : 64) << 20;
+}
+
+TranspositionTable &process_tt()
+{
+    static TranspositionTable tt(initial_size());
+    return tt;
+}
@@ -0,0 +1,78 @@
+#ifndef TRANSPOSITION_TABLE_H
+#define TRANSPOSITION_TABLE_H
+
+#include <cstddef>
+#include <stdint.h>
+
+enum TTFlag
+{
+    TT_EXACT,
+    TT_LOWER,
+    TT_UPPER
+};
+
+struct TTEntry
+{
+    short value;
+    short move; // the search's own move number, -1 if none
+    signed char depth;
+    unsigned char flag;
+};
+
+// A fixed size table of search results shared by any number of threads
+// without locks. Each slot is two words, the packed entry and the key XORed
+// with it, written and read separately; a slot torn by two threads storing
+// at once no longer XORs back to its key and reads as a miss.
+//
+// Slots come four to a cache line. A store goes over the slot with the same
+// key if it searched at least as deep, otherwise over the shallowest slot of
+// the line, counting slots left from older searches as shallower than they
+// are. The table is backed by huge pages where the system has them.
+class TranspositionTable
+{
+    public:
+        explicit TranspositionTable(size_t bytes);
+        ~TranspositionTable();
+
+        size_t size_bytes() const { return nbuckets * sizeof(Bucket); }
+
+        bool probe(uint64_t key, TTEntry &entry) const;
+        void store(uint64_t key, const TTEntry &entry);
+
+        // ages every entry, for a new search of the same game
+        void new_search() { generation = (generation + 1) & 0xff; }
+        // forgets every entry, for a different game
+        void clear();
+
+    private:
+        TranspositionTable(const TranspositionTable &);
+        TranspositionTable &operator=(const TranspositionTable &);
+
+        static const int SLOTS = 4;
+
+        struct Slot
+        {
+            uint64_t check; // key ^ data
+            uint64_t data; // 0 if empty
+        };
+
+        struct Bucket
+        {
+            Slot slots[SLOTS];
+        } __attribute__((aligned(64)));
+
+        static uint64_t pack(const TTEntry &entry, int generation);
+        static TTEntry unpack(uint64_t data);
+        static int age(uint64_t data, int generation);
+
+        Bucket *buckets;
+        size_t nbuckets; // a power of 2
+        size_t map_size;
+        int generation;
+};
+
+// the table the searches share, DOTS_TT_MB megabytes (64 by default) given
+// when it is first used
+TranspositionTable &process_tt();
+
+#endif